@@ -63,6 +63,8 @@ int main()
   G.add_node<B>().set_name("B");
   G.add_node<C>().set_name("C");
 
+  G.compile();    // freeze the graph into a flat execution plan
+
   G.print();
 
   graphe::serial_executor Exec(G);
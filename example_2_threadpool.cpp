@@ -72,7 +72,7 @@ struct ThreadPoolWrapper
     }
     void operator()( std::function<void(void)> & exec)
     {
-        m_threadpool->push(exec);
+        m_threadpool->post( [&exec]{ exec(); } ); // exec lives as long as the graph
     }
     gnl::thread_pool *m_threadpool;
 };
@@ -85,6 +85,8 @@ int main()
   G.add_node<B>().set_name("B");
   G.add_node<C>().set_name("C");
 
+  G.compile();    // freeze the graph into a flat execution plan
+
   G.print();
 
   gnl::thread_pool T(4);   // create the threadpool with 4 workers
@@ -79,7 +79,7 @@ struct ThreadPoolWrapper
     }
     void operator()( std::function<void(void)> & exec)
     {
-        m_threadpool->push(exec);
+        m_threadpool->post( [&exec]{ exec(); } ); // exec lives as long as the graph
     }
     gnl::thread_pool *m_threadpool;
 };
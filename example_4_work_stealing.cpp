@@ -0,0 +1,107 @@
+#include <iostream>
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+
+#include "gnl/gnl_work_stealing_pool.h"
+
+class A
+{
+public:
+    graphe::out_resource<int> b;
+    graphe::out_resource<int> c;
+
+    A( graphe::ResourceRegistry & G)
+    {
+        b = G.register_output_resource<int>("b");
+        c = G.register_output_resource<int>("c");
+    }
+    void operator()()
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds(500));
+        b.emplace<int>(3);
+        b.make_available();
+        std::this_thread::sleep_for( std::chrono::milliseconds(500));
+        c.emplace<int>(10);
+        c.make_available();
+    }
+};
+
+class B
+{
+public:
+    graphe::in_resource<int> b;
+
+    B( graphe::ResourceRegistry & G)
+    {
+        b = G.register_input_resource<int>("b");
+    }
+    void operator()()
+    {
+        std::cout << b.get() << std::endl;
+        std::this_thread::sleep_for( std::chrono::milliseconds(500));
+    }
+};
+
+class C
+{
+public:
+    graphe::in_resource<int> c;
+
+    C( graphe::ResourceRegistry & G)
+    {
+        c = G.register_input_resource<int>("c");
+    }
+    void operator()()
+    {
+        std::cout << c.get() << std::endl;
+        std::this_thread::sleep_for( std::chrono::milliseconds(500));
+    }
+};
+
+/**
+ * @brief The WorkStealingWrapper struct
+ * The exec_node's execute function lives as long as the graph
+ * so it can be pushed by reference, without copying it.
+ * Nodes scheduled from within a running node are placed on
+ * that worker's own deque.
+ */
+struct WorkStealingWrapper
+{
+    WorkStealingWrapper( gnl::work_stealing_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->push_ref(exec);
+    }
+    gnl::work_stealing_pool *m_threadpool;
+};
+
+int main()
+{
+  graphe::node_graph G;
+
+  G.add_node<A>().set_name("A");
+  G.add_node<B>().set_name("B");
+  G.add_node<C>().set_name("C");
+
+  G.compile();
+
+  gnl::work_stealing_pool T(4);   // create the threadpool with 4 workers
+  WorkStealingWrapper TW(T);      // create the wrapper.
+
+  graphe::threaded_executor<WorkStealingWrapper> Exec(G); // create the executor
+  Exec.set_thread_pool(&TW); // set the threadpool wrapper
+
+  Exec.execute(); // execute
+  Exec.wait();    // wait until all the nodes have executed.
+
+  G.reset();
+
+  Exec.execute();
+  Exec.wait();
+
+  G.print();
+
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+
+#include "gnl/gnl_threadpool.h"
+
+class Positions
+{
+public:
+    graphe::out_resource< std::vector<float> > x;
+
+    Positions( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource< std::vector<float> >("x");
+    }
+    void operator()()
+    {
+        std::vector<float> v(1000000);
+        for(size_t i=0;i<v.size();i++)
+            v[i] = static_cast<float>(i);
+        x.set( std::move(v) );
+    }
+};
+
+/**
+ * @brief The Update class
+ *
+ * A parallel node. Instead of operator()(), it provides the size of the
+ * range to process, the size of each chunk, and an operator() which
+ * processes a single chunk. The chunks are executed across the thread
+ * pool and the output resource is made available once all of them
+ * have finished.
+ */
+class Update
+{
+public:
+    graphe::in_resource< std::vector<float> >  x;
+    graphe::out_resource< std::vector<float> > y;
+
+    Update( graphe::ResourceRegistry & G)
+    {
+        x = G.register_input_resource< std::vector<float> >("x");
+        y = G.register_output_resource< std::vector<float> >("y");
+    }
+
+    void prepare() // optional: called once before the chunks are executed
+    {
+        y.emplace( x.get().size() );
+    }
+
+    std::size_t size()
+    {
+        return x.get().size();
+    }
+
+    std::size_t chunk_size()
+    {
+        return 16384;
+    }
+
+    void operator()(std::size_t begin, std::size_t end)
+    {
+        auto & X = x.get();
+        auto & Y = y.get();
+        for(auto i=begin; i<end; i++)
+            Y[i] = std::sqrt( X[i] );
+    }
+};
+
+class Sum
+{
+public:
+    graphe::in_resource< std::vector<float> > y;
+
+    Sum( graphe::ResourceRegistry & G)
+    {
+        y = G.register_input_resource< std::vector<float> >("y");
+    }
+    void operator()()
+    {
+        double s = 0;
+        for(auto v : y.get())
+            s += v;
+        std::cout << "Sum: " << s << std::endl;
+    }
+};
+
+struct ThreadPoolWrapper
+{
+    ThreadPoolWrapper( gnl::thread_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->post( [&exec]{ exec(); } ); // exec lives as long as the graph
+    }
+    gnl::thread_pool *m_threadpool;
+};
+
+int main()
+{
+  graphe::node_graph G;
+
+  G.add_node<Positions>().set_name("Positions");
+  G.add_parallel_node<Update>().set_name("Update");
+  G.add_node<Sum>().set_name("Sum");
+
+  G.compile();
+
+  gnl::thread_pool T(4);   // create the threadpool with 4 workers
+  ThreadPoolWrapper TW(T); // create the wrapper.
+
+  graphe::threaded_executor<ThreadPoolWrapper> Exec(G); // create the executor
+  Exec.set_thread_pool(&TW); // set the threadpool wrapper
+
+  for(int i=0;i<3;i++)
+  {
+      Exec.execute();
+      Exec.wait();
+      G.reset();
+  }
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include "graph-e/node_graph.h"
+#include "graph-e/multi_graph_executor.h"
+
+#include "gnl/gnl_threadpool.h"
+
+/**
+ * @brief The Work class
+ *
+ * A node which keeps a worker busy for a given number of milliseconds.
+ */
+class Work
+{
+public:
+    int ms;
+
+    Work( graphe::ResourceRegistry &, int _ms) : ms(_ms)
+    {
+    }
+    void operator()()
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds(ms) );
+    }
+};
+
+class Request
+{
+public:
+    graphe::out_resource<int> reply;
+
+    Request( graphe::ResourceRegistry & G)
+    {
+        reply = G.register_output_resource<int>("reply");
+    }
+    void operator()()
+    {
+        reply.set(42);
+    }
+};
+
+class Respond
+{
+public:
+    graphe::in_resource<int> reply;
+
+    Respond( graphe::ResourceRegistry & G)
+    {
+        reply = G.register_input_resource<int>("reply");
+    }
+    void operator()()
+    {
+        std::cout << "Reply: " << reply.get() << std::endl;
+    }
+};
+
+struct ThreadPoolWrapper
+{
+    ThreadPoolWrapper( gnl::thread_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->post( [&exec]{ exec(); } ); // exec lives as long as the executor
+    }
+    gnl::thread_pool *m_threadpool;
+};
+
+int main()
+{
+  // a batch graph with many independent, slow nodes
+  graphe::node_graph Batch;
+  for(int i=0;i<32;i++)
+      Batch.add_node<Work>(10);
+
+  // a small, latency sensitive graph
+  graphe::node_graph Session;
+  Session.add_node<Request>().set_name("Request");
+  Session.add_node<Respond>().set_name("Respond");
+
+  gnl::thread_pool T(4);   // create the threadpool with 4 workers
+  ThreadPoolWrapper TW(T); // create the wrapper.
+
+  graphe::multi_graph_executor<ThreadPoolWrapper> Exec;
+  Exec.set_thread_pool(&TW);
+
+  auto batch   = Exec.add_graph(Batch, 1, 3); // never uses more than 3 of the 4 workers
+  auto session = Exec.add_graph(Session, 4);
+
+  auto batch_done = Exec.execute(batch);
+
+  for(int i=0;i<3;i++)
+  {
+      auto t0 = std::chrono::steady_clock::now();
+      Exec.execute(session).get();
+      auto t1 = std::chrono::steady_clock::now();
+      std::cout << "Session frame took " << std::chrono::duration<double, std::milli>(t1-t0).count() << " ms" << std::endl;
+      Session.reset();
+  }
+
+  batch_done.get();
+  std::cout << "Batch finished" << std::endl;
+
+  return 0;
+}
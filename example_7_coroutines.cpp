@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include "graph-e/node_graph.h"
+#include "graph-e/coro_node.h"
+#include "graph-e/threaded_executor.h"
+
+#include "gnl/gnl_threadpool.h"
+
+// Requires C++20.
+
+/**
+ * @brief The Fetch class
+ *
+ * An asynchronous node. Its () operator is a coroutine which waits for a
+ * timer without holding a thread, so many of them can wait at the same
+ * time on a small thread pool.
+ */
+class Fetch
+{
+public:
+    graphe::out_resource<int> value;
+    int i;
+
+    Fetch( graphe::ResourceRegistry & G, int _i) : i(_i)
+    {
+        value = G.register_output_resource<int>( "value_" + std::to_string(i) );
+    }
+    graphe::node_task operator()()
+    {
+        co_await graphe::sleep_for( std::chrono::milliseconds(50) );
+        value.set(i);
+    }
+};
+
+/**
+ * @brief The Read class
+ *
+ * Waits for a value produced by another thread, eg: the completion of an
+ * asynchronous read.
+ */
+class Read
+{
+public:
+    graphe::out_resource<int>   bytes;
+    graphe::completion<int>     m_done;
+    std::thread                 m_io;
+
+    Read( graphe::ResourceRegistry & G)
+    {
+        bytes = G.register_output_resource<int>("bytes");
+    }
+    ~Read()
+    {
+        if( m_io.joinable() )
+            m_io.join();
+    }
+    graphe::node_task operator()()
+    {
+        if( m_io.joinable() )
+            m_io.join();
+
+        m_done.reset();
+        m_io = std::thread( [this]
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds(20) );
+            m_done.set(512);
+        });
+        bytes.set( co_await m_done );
+    }
+};
+
+class Total
+{
+public:
+    std::vector< graphe::in_resource<int> > values;
+    graphe::in_resource<int> bytes;
+
+    Total( graphe::ResourceRegistry & G, int n)
+    {
+        for(int i=0;i<n;i++)
+            values.push_back( G.register_input_resource<int>( "value_" + std::to_string(i) ) );
+        bytes = G.register_input_resource<int>("bytes");
+    }
+    void operator()()
+    {
+        int t = 0;
+        for(auto & v : values)
+            t += v.get();
+        std::cout << "Total: " << t << "  bytes: " << bytes.get() << std::endl;
+    }
+};
+
+struct ThreadPoolWrapper
+{
+    ThreadPoolWrapper( gnl::thread_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->post( [&exec]{ exec(); } ); // exec lives as long as the graph
+    }
+    gnl::thread_pool *m_threadpool;
+};
+
+int main()
+{
+  const int n = 32;
+
+  graphe::node_graph G;
+  for(int i=0;i<n;i++)
+      G.add_async_node<Fetch>(i);
+  G.add_async_node<Read>().set_name("Read");
+  G.add_node<Total>(n).set_name("Total");
+
+  gnl::thread_pool T(2);   // 2 workers, for 33 nodes which wait
+  ThreadPoolWrapper TW(T);
+
+  graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+  Exec.set_thread_pool(&TW);
+
+  for(int i=0;i<3;i++)
+  {
+      auto t0 = std::chrono::steady_clock::now();
+      Exec.execute();
+      Exec.wait();
+      auto t1 = std::chrono::steady_clock::now();
+      std::cout << "Frame took " << std::chrono::duration<double, std::milli>(t1-t0).count() << " ms" << std::endl;
+      G.reset();
+  }
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#define GRAPHE_TRACK_ALLOCATIONS // replace the global operator new in this program
+#include "graph-e/alloc_tracker.h"
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "graph-e/threaded_executor.h"
+#include "gnl/gnl_threadpool.h"
+
+class A
+{
+public:
+    graphe::out_resource<std::vector<float>> b;
+    graphe::out_resource<int>                c;
+
+    A( graphe::ResourceRegistry & G)
+    {
+        b = G.register_output_resource<std::vector<float>>("b");
+        c = G.register_output_resource<int>("c");
+    }
+    void operator()()
+    {
+        // the vector is only constructed in the first frame, after
+        // that its capacity is reused
+        if( !b.has_value() )
+            b.emplace();
+        b.get().assign(1024, 1.0f);
+        b.make_available();
+        c.set(10);
+    }
+};
+
+class B
+{
+public:
+    graphe::in_resource<std::vector<float>> b;
+    graphe::in_resource<int>                c;
+    graphe::out_resource<float>             d;
+
+    B( graphe::ResourceRegistry & G)
+    {
+        b = G.register_input_resource<std::vector<float>>("b");
+        c = G.register_input_resource<int>("c");
+        d = G.register_output_resource<float>("d");
+    }
+    void operator()()
+    {
+        float sum = 0;
+        for(auto x : b.get())
+            sum += x;
+        d.set( sum * static_cast<float>(c.get()) );
+    }
+};
+
+class C
+{
+public:
+    graphe::in_resource<int>   c;
+    graphe::out_resource<int>  e;
+
+    C( graphe::ResourceRegistry & G)
+    {
+        c = G.register_input_resource<int>("c");
+        e = G.register_output_resource<int>("e");
+    }
+    void operator()()
+    {
+        e.set( c.get() + 1 );
+    }
+};
+
+struct ThreadPoolWrapper
+{
+    ThreadPoolWrapper( gnl::thread_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->post( [&exec]{ exec(); } ); // does not allocate, see gnl::thread_pool::post
+    }
+    gnl::thread_pool *m_threadpool;
+};
+
+/**
+ * Runs a few frames to reach the steady state, then runs 100 frames
+ * with the allocation tracker in trap mode: the program aborts if
+ * any thread allocates during those frames.
+ */
+template<typename F>
+void run_frames(char const * name, graphe::node_graph & G, F && frame)
+{
+    for(int i=0; i < 3; ++i)
+    {
+        frame();
+        G.reset();
+    }
+
+    graphe::allocation_tracker::begin(true);
+    for(int i=0; i < 100; ++i)
+    {
+        frame();
+        G.reset();
+    }
+    auto n = graphe::allocation_tracker::end();
+
+    std::cout << name << ": " << n << " allocations in 100 frames" << std::endl;
+}
+
+int main()
+{
+  {
+      // B and C are independent of A's vector, so they
+      // may be executed in either order
+      graphe::node_graph G;
+      G.add_node<A>().set_name("A");
+      G.add_node<B>().set_name("B");
+      G.add_node<C>().set_name("C");
+      G.compile(); // the compiled plan avoids locking the nodes' weak pointers
+
+      graphe::serial_executor Exec(G);
+      run_frames("serial_executor", G, [&]{ Exec.execute(); });
+  }
+
+  {
+      graphe::node_graph G;
+      G.add_node<A>().set_name("A");
+      G.add_node<B>().set_name("B");
+      G.add_node<C>().set_name("C");
+      G.compile();
+
+      gnl::thread_pool T(4);
+      ThreadPoolWrapper TW(T);
+
+      graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+      Exec.set_thread_pool(&TW);
+      run_frames("threaded_executor", G, [&]{ Exec.execute(); Exec.wait(); });
+  }
+
+  return 0;
+}
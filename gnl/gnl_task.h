@@ -0,0 +1,233 @@
+#ifndef GNL_TASK_H
+#define GNL_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <type_traits>
+
+#ifndef GNL_NAMESPACE
+    #define GNL_NAMESPACE gnl
+#endif
+namespace GNL_NAMESPACE
+{
+
+/**
+ * @brief The task class
+ *
+ * A move-only, type-erased void() callable. Callables which fit into
+ * buffer_size bytes (and can be moved without throwing) are stored inside
+ * the task itself, so creating, moving and running a task does not
+ * allocate. Larger callables are placed on the heap.
+ */
+class task
+{
+    public:
+        static constexpr std::size_t buffer_size = 6*sizeof(void*);
+
+        task() noexcept = default;
+
+        template<class F,
+                 typename = typename std::enable_if< !std::is_same<typename std::decay<F>::type, task>::value >::type>
+        task(F && f)
+        {
+            using T = typename std::decay<F>::type;
+            if constexpr ( stored_inline<T>() )
+            {
+                new (&m_storage) T( std::forward<F>(f) );
+                m_vtable = &inline_vtable<T>::value;
+            }
+            else
+            {
+                *reinterpret_cast<T**>(&m_storage) = new T( std::forward<F>(f) );
+                m_vtable = &heap_vtable<T>::value;
+            }
+        }
+
+        task(task && other) noexcept
+        {
+            move_from(other);
+        }
+
+        task & operator=(task && other) noexcept
+        {
+            if( this != &other )
+            {
+                reset();
+                move_from(other);
+            }
+            return *this;
+        }
+
+        task(task const &) = delete;
+        task & operator=(task const &) = delete;
+
+        ~task()
+        {
+            reset();
+        }
+
+        /**
+         * @brief operator ()
+         *
+         * Execute the callable. The task must not be empty.
+         */
+        void operator()()
+        {
+            m_vtable->invoke(&m_storage);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return m_vtable != nullptr;
+        }
+
+        /**
+         * @brief reset
+         *
+         * Destroys the stored callable, leaving the task empty.
+         */
+        void reset() noexcept
+        {
+            if( m_vtable )
+            {
+                m_vtable->destroy(&m_storage);
+                m_vtable = nullptr;
+            }
+        }
+
+        /**
+         * @brief stored_inline
+         * @return
+         *
+         * Returns true if a callable of type T is stored without allocating.
+         */
+        template<typename T>
+        static constexpr bool stored_inline()
+        {
+            return sizeof(T) <= buffer_size &&
+                   alignof(T) <= alignof(std::max_align_t) &&
+                   std::is_nothrow_move_constructible<T>::value;
+        }
+
+    protected:
+        struct vtable
+        {
+            void (*invoke)(void*);
+            void (*move)(void* dst, void* src);   // move construct dst from src and destroy src
+            void (*destroy)(void*);
+        };
+
+        template<typename T>
+        struct inline_vtable
+        {
+            static constexpr vtable value = {
+                [](void* p) { (*static_cast<T*>(p))(); },
+                [](void* dst, void* src) { new (dst) T( std::move(*static_cast<T*>(src)) ); static_cast<T*>(src)->~T(); },
+                [](void* p) { static_cast<T*>(p)->~T(); }
+            };
+        };
+
+        template<typename T>
+        struct heap_vtable
+        {
+            static constexpr vtable value = {
+                [](void* p) { (**static_cast<T**>(p))(); },
+                [](void* dst, void* src) { *static_cast<T**>(dst) = *static_cast<T**>(src); },
+                [](void* p) { delete *static_cast<T**>(p); }
+            };
+        };
+
+        void move_from(task & other) noexcept
+        {
+            if( other.m_vtable )
+            {
+                other.m_vtable->move(&m_storage, &other.m_storage);
+                m_vtable = other.m_vtable;
+                other.m_vtable = nullptr;
+            }
+        }
+
+        alignas(std::max_align_t) unsigned char m_storage[buffer_size];
+        vtable const * m_vtable = nullptr;
+};
+
+/**
+ * @brief The ring_queue class
+ *
+ * A FIFO queue stored in a circular buffer. The buffer only grows,
+ * so once it has reached its working size, pushing and popping items does
+ * not allocate.
+ */
+template<typename T>
+class ring_queue
+{
+    public:
+        explicit ring_queue(std::size_t capacity = 64) : m_items(capacity ? capacity : 1)
+        {
+        }
+
+        void push(T && t)
+        {
+            if( m_size == m_items.size() )
+                grow();
+            m_items[ (m_head + m_size) % m_items.size() ] = std::move(t);
+            ++m_size;
+        }
+
+        void push(T const & t)
+        {
+            push( T(t) );
+        }
+
+        /**
+         * @brief pop
+         * @return
+         *
+         * Removes and returns the item at the front of the queue. The queue
+         * must not be empty.
+         */
+        T pop()
+        {
+            T t = std::move( m_items[m_head] );
+            m_head = (m_head + 1) % m_items.size();
+            --m_size;
+            return t;
+        }
+
+        std::size_t size() const  { return m_size; }
+        bool        empty() const { return m_size == 0; }
+
+        void clear()
+        {
+            while( m_size ) pop();
+        }
+
+    protected:
+        void grow()
+        {
+            std::vector<T> items( m_items.size() * 2 );
+            for(std::size_t i=0; i < m_size; ++i)
+            {
+                items[i] = std::move( m_items[ (m_head + i) % m_items.size() ] );
+            }
+            m_items.swap(items);
+            m_head = 0;
+        }
+
+        std::vector<T> m_items;
+        std::size_t    m_head = 0;
+        std::size_t    m_size = 0;
+};
+
+/**
+ * @brief task_queue
+ *
+ * The FIFO queue of tasks used by the thread pools.
+ */
+using task_queue = ring_queue<task>;
+
+}
+#endif
@@ -10,31 +10,172 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 
+#include "gnl_task.h"
+#include "gnl_topology.h"
+
 #ifndef GNL_NAMESPACE
     #define GNL_NAMESPACE gnl
 #endif
 namespace GNL_NAMESPACE
 {
 
+/**
+ * @brief The pin_policy enum
+ *
+ * How the workers of a thread_pool are placed on the cpus.
+ */
+enum class pin_policy
+{
+    none,      // workers may run on any cpu
+    cpu,       // each worker is pinned to one cpu, filling one NUMA node before the next
+    numa_node  // workers are spread over the NUMA nodes, and may run on any cpu of their node
+};
+
+/**
+ * @brief The idle_policy struct
+ *
+ * What a worker does when it finds the queue empty. It first polls the
+ * queue spin times, executing a pause instruction between polls, then
+ * yields its time slice yields times, and finally parks on the condition
+ * variable. Producers only notify the condition variable if a worker is
+ * parked.
+ *
+ * With adaptive, each worker tunes its own spin budget between spin/64
+ * and spin: the budget is doubled when a task arrived while spinning and
+ * halved when the worker had to park, so workers spin while tasks arrive
+ * in quick succession and park quickly when they do not.
+ *
+ * The default parks immediately.
+ */
+struct idle_policy
+{
+    std::uint32_t spin     = 0;
+    std::uint32_t yields   = 0;
+    bool          adaptive = false;
+
+    /**
+     * @brief spin_then_park
+     * @return
+     *
+     * Suitable for graphs which release many short nodes in bursts.
+     */
+    static idle_policy spin_then_park()
+    {
+        return idle_policy{ 1u << 14, 16, true };
+    }
+};
+
+/**
+ * @brief cpu_relax
+ *
+ * Tells the cpu the calling thread is busy waiting.
+ */
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
 class thread_pool
 {
 
     public:
-        thread_pool(size_t num_threads);
+        thread_pool(size_t num_threads, pin_policy pin = pin_policy::none);
         thread_pool();
 
 
         template<class F, class... Args>
         std::future<typename std::result_of<F(Args...)>::type> push( F && f, Args &&... args);
 
+        /**
+         * @brief post
+         * @param f
+         *
+         * Push a callable onto the queue without creating a future. The callable
+         * is moved into a gnl::task stored directly in the queue, so small callables
+         * (eg: a lambda capturing a pointer) do not allocate any memory.
+         */
+        template<class F>
+        void post(F && f);
+
+        /**
+         * @brief post
+         * @param f
+         * @param numa_node - index of the preferred NUMA node, in cpu_topology::nodes()
+         *
+         * Same as post(f), but the task is preferably executed by a worker
+         * of the given node. Workers only run tasks preferring another
+         * node once there are none for their own. Without the
+         * pin_policy::numa_node policy, there is a single group and the
+         * preference is ignored. A negative node means no preference.
+         */
+        template<class F>
+        void post(F && f, int numa_node);
+
+        /**
+         * @brief num_groups
+         * @return
+         *
+         * Returns the number of groups of workers, ie: the number of NUMA
+         * nodes with the pin_policy::numa_node policy, otherwise 1.
+         */
+        std::size_t num_groups() const { return m_tasks.size(); }
+
+        /**
+         * @brief set_idle_policy
+         * @param p
+         *
+         * Sets what idle workers do before parking. Can be changed at any time.
+         */
+        void set_idle_policy(idle_policy const & p)
+        {
+            m_spin.store(p.spin, std::memory_order_relaxed);
+            m_yields.store(p.yields, std::memory_order_relaxed);
+            m_adaptive.store(p.adaptive, std::memory_order_relaxed);
+        }
+
+        idle_policy get_idle_policy() const
+        {
+            return idle_policy{ m_spin.load(std::memory_order_relaxed),
+                                m_yields.load(std::memory_order_relaxed),
+                                m_adaptive.load(std::memory_order_relaxed) };
+        }
+
+        /**
+         * @brief num_parked
+         * @return
+         *
+         * Returns the number of workers sleeping on the condition variable.
+         */
+        std::size_t num_parked() { std::unique_lock<std::mutex> lock(m_mutex); return m_parked; }
+
         /**
          * @brief create_workers
          * @param num
          * Creates a new worker to work the threadpool
          */
         void create_workers(std::size_t num);
+
+        /**
+         * @brief create_workers
+         * @param num
+         * @param cpus
+         *
+         * Creates new workers pinned to the given cpus. With the
+         * pin_policy::numa_node policy, they belong to the group of the
+         * node of the first cpu.
+         */
+        void create_workers(std::size_t num, cpu_set const & cpus);
         /**
          * @brief remove_thread
          * Remove a worker from the thread pool
@@ -53,7 +194,7 @@ class thread_pool
          *
          * Returns the number of tasks still in the queue
          */
-        std::size_t num_tasks() { return m_tasks.size(); }
+        std::size_t num_tasks() { std::unique_lock<std::mutex> lock(m_mutex); return m_num_tasks.load(std::memory_order_relaxed); }
 
         /**
          * @brief num_workers
@@ -75,12 +216,53 @@ class thread_pool
          */
         void add_thread();
 
+        /**
+         * @brief add_thread
+         * @param cpus - the cpus the worker is pinned to, empty for any
+         * @param group - the group whose tasks the worker runs first
+         */
+        void add_thread(cpu_set cpus, std::size_t group);
+
+        /**
+         * @brief pop_task
+         *
+         * Removes the next task, preferring the given group. m_mutex
+         * must be held and there must be a task.
+         */
+        task pop_task(std::size_t group);
+
+        /**
+         * @brief push_task
+         *
+         * Queues the task. m_mutex must be held. Returns true if a parked
+         * worker needs to be notified.
+         */
+        bool push_task(task && t, std::size_t group);
+
+        /**
+         * @brief spin_for_task
+         * @param budget - the worker's spin budget, updated when adaptive
+         *
+         * Busy waits according to the idle policy until a task has been
+         * queued. Returns false if the worker should park.
+         */
+        bool spin_for_task(std::uint32_t & budget);
+
 
         // need to keep track of threads so we can join them
         std::vector< std::thread > workers;
 
-        // the task queue
-        std::queue< std::function<void()> > m_tasks;
+        // the task queues, one per group of workers
+        std::vector<task_queue> m_tasks = std::vector<task_queue>(1);
+        std::atomic<std::size_t> m_num_tasks{0};  // only modified under m_mutex, polled by spinning workers
+        std::uint32_t           m_parked = 0;      // workers waiting on m_cv
+
+        std::atomic<std::uint32_t> m_spin{0};
+        std::atomic<std::uint32_t> m_yields{0};
+        std::atomic<bool>          m_adaptive{false};
+
+        pin_policy              m_pin = pin_policy::none;
+        std::size_t             m_next_worker = 0; // placement index of the next worker
 
         // synchronization
         std::mutex              m_mutex;
@@ -94,7 +276,11 @@ class thread_pool
 
 inline void thread_pool::remove_worker()
 {
-    --m_thread_count;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        --m_thread_count;
+    }
+    m_cv.notify_all();
 }
 
 inline void thread_pool::create_workers(std::size_t num)
@@ -103,21 +289,69 @@ inline void thread_pool::create_workers(std::size_t num)
     {
         add_thread();
     }
-    if( m_tasks.size())
+    if( num_tasks() )
+        m_cv.notify_all();
+}
+
+inline void thread_pool::create_workers(std::size_t num, cpu_set const & cpus)
+{
+    auto & T = cpu_topology::get();
+    auto group = cpus.empty() ? 0 : T.node_of(cpus.front()) % m_tasks.size();
+    for(size_t i=0;i<num;++i)
+    {
+        add_thread(cpus, group);
+    }
+    if( num_tasks() )
         m_cv.notify_all();
 }
 
 inline void thread_pool::add_thread()
 {
-    ++m_thread_count;
-    ++m_worker_count;
+    auto & T = cpu_topology::get();
+    auto i   = m_next_worker++;
+
+    switch( m_pin )
+    {
+        case pin_policy::cpu:
+        {
+            auto cpus = T.cpus();
+            auto cpu  = cpus[ i % cpus.size() ];
+            add_thread( cpu_set{cpu}, T.node_of(cpu) % m_tasks.size() );
+            break;
+        }
+        case pin_policy::numa_node:
+        {
+            auto n = i % T.num_nodes();
+            add_thread( T.nodes()[n].cpus, n % m_tasks.size() );
+            break;
+        }
+        default:
+            add_thread( cpu_set{}, 0 );
+    }
+}
+
+inline void thread_pool::add_thread(cpu_set cpus, std::size_t group)
+{
+    {
+        // the counters are read by running workers under the lock
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_thread_count;
+        ++m_worker_count;
+    }
 
     workers.emplace_back(
-        [this]
+        [this, cpus, group]
         {
+            if( !cpus.empty() )
+                pin_this_thread(cpus); // falls back to running unpinned
+
+            std::uint32_t budget = m_spin.load(std::memory_order_relaxed);
             for(;;)
             {
-                std::function<void()> task;
+                gnl::task task;
+
+                if( m_num_tasks.load(std::memory_order_relaxed) == 0 )
+                    spin_for_task(budget);
 
                 {
                     std::unique_lock<std::mutex> lock(this->m_mutex);
@@ -125,7 +359,13 @@ inline void thread_pool::add_thread()
                     // Wait for someone to trigger the condition variable.
                     // But do not wait if the task list is empty
                     //this->m_cv.wait(lock, [this]{ return this->stop || !this->m_tasks.empty(); });
-                    this->m_cv.wait(lock, [this]{ return (m_thread_count < m_worker_count) || !this->m_tasks.empty(); });
+                    auto ready = [this]{ return (m_thread_count < m_worker_count) || this->m_num_tasks.load(std::memory_order_relaxed) != 0; };
+                    if( !ready() )
+                    {
+                        ++m_parked;
+                        this->m_cv.wait(lock, ready);
+                        --m_parked;
+                    }
 
                     //  ========== Start Safe Zone =========================
                     //if( (this->stop && this->m_tasks.empty()) || (m_thread_count < m_worker_count) )
@@ -137,8 +377,7 @@ inline void thread_pool::add_thread()
                         return;
                     }
 
-                    task = std::move(this->m_tasks.front());
-                    this->m_tasks.pop();
+                    task = pop_task(group);
                     //std::cout << std::this_thread::get_id() << " Starting Task! " << m_tasks.size() << " tasks left" << std::endl;
                     //  ========== End Safe Zone =========================
                 }
@@ -149,10 +388,14 @@ inline void thread_pool::add_thread()
 }
 
 // The constructor just launches some amount of workers
-inline thread_pool::thread_pool(size_t threads)
+inline thread_pool::thread_pool(size_t threads, pin_policy pin)
     : m_worker_count(0), m_thread_count(0)
 //    :   stop(false)
 {
+    m_pin = pin;
+    if( pin == pin_policy::numa_node )
+        m_tasks.resize( cpu_topology::get().num_nodes() );
+
     for(size_t i = 0;i<threads;++i)
     {
         add_thread();
@@ -167,7 +410,60 @@ inline thread_pool::thread_pool()  : m_worker_count(0), m_thread_count(0)
 inline void thread_pool::clear_tasks()
 {
     std::unique_lock<std::mutex> lock(m_mutex);
-    while(m_tasks.size()) m_tasks.pop();
+    for(auto & q : m_tasks)
+        q.clear();
+    m_num_tasks.store(0, std::memory_order_relaxed);
+}
+
+inline bool thread_pool::spin_for_task(std::uint32_t & budget)
+{
+    auto spin     = m_spin.load(std::memory_order_relaxed);
+    auto yields   = m_yields.load(std::memory_order_relaxed);
+    auto adaptive = m_adaptive.load(std::memory_order_relaxed);
+    if( !adaptive )
+        budget = spin;
+    budget = std::min(budget, spin);
+
+    auto has_task = [this]{ return m_num_tasks.load(std::memory_order_relaxed) != 0; };
+    bool found = false;
+    for(std::uint32_t i=0; i < budget && !found; ++i)
+    {
+        cpu_relax();
+        found = has_task();
+    }
+    for(std::uint32_t i=0; i < yields && !found; ++i)
+    {
+        std::this_thread::yield();
+        found = has_task();
+    }
+
+    if( adaptive )
+    {
+        auto lo = std::max<std::uint32_t>(1, spin / 64);
+        budget  = found ? std::min(spin, std::max(lo, budget * 2))
+                        : std::max(lo, budget / 2);
+    }
+    return found;
+}
+
+inline task thread_pool::pop_task(std::size_t group)
+{
+    m_num_tasks.fetch_sub(1, std::memory_order_relaxed);
+    if( !m_tasks[group].empty() )
+        return m_tasks[group].pop();
+    for(auto & q : m_tasks)
+    {
+        if( !q.empty() )
+            return q.pop();
+    }
+    return task(); // unreachable while m_num_tasks is correct
+}
+
+inline bool thread_pool::push_task(task && t, std::size_t group)
+{
+    m_tasks[group].push( std::move(t) );
+    m_num_tasks.fetch_add(1, std::memory_order_relaxed);
+    return m_parked != 0; // spinning workers see the task without a notification
 }
 
 // add new work item to the pool
@@ -184,6 +480,7 @@ std::future< RETURN_TYPE > thread_pool::push(F&& f, Args&&... args)
                 );
 
     std::future<return_type> res = task->get_future();
+    bool wake;
     {
         std::unique_lock<std::mutex> lock(m_mutex);
 
@@ -191,12 +488,33 @@ std::future< RETURN_TYPE > thread_pool::push(F&& f, Args&&... args)
         //if(stop)
         //    throw std::runtime_error("enqueue on stopped ThreadPool");
 
-        m_tasks.emplace([task](){ (*task)(); });
+        wake = push_task( [task](){ (*task)(); }, 0 );
     }
-    m_cv.notify_one();
+    if( wake )
+        m_cv.notify_one();
     return res;
 }
 
+template<class F>
+void thread_pool::post(F && f)
+{
+    post( std::forward<F>(f), -1 );
+}
+
+template<class F>
+void thread_pool::post(F && f, int numa_node)
+{
+    gnl::task t( std::forward<F>(f) ); // construct outside of the lock
+    bool wake;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto group = numa_node < 0 ? 0 : static_cast<std::size_t>(numa_node) % m_tasks.size();
+        wake = push_task( std::move(t), group );
+    }
+    if( wake )
+        m_cv.notify_one();
+}
+
 // the destructor joins all threads
 inline thread_pool::~thread_pool()
 {
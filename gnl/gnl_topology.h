@@ -0,0 +1,248 @@
+#ifndef GNL_TOPOLOGY_H
+#define GNL_TOPOLOGY_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+#ifndef GNL_NAMESPACE
+    #define GNL_NAMESPACE gnl
+#endif
+namespace GNL_NAMESPACE
+{
+
+using cpu_set = std::vector<int>; // a list of logical cpu ids
+
+/**
+ * @brief parse_cpu_list
+ * @param s - eg: "0-3,8-11"
+ * @return
+ *
+ * Parses a cpu list in the format used by /sys/devices/system.
+ */
+inline cpu_set parse_cpu_list(std::string const & s)
+{
+    cpu_set cpus;
+    std::size_t i = 0;
+    auto number = [&](int & x)
+    {
+        auto start = i;
+        x = 0;
+        while( i < s.size() && s[i] >= '0' && s[i] <= '9' )
+            x = x*10 + (s[i++] - '0');
+        return i != start;
+    };
+
+    while( i < s.size() )
+    {
+        int a, b;
+        if( !number(a) )
+        {
+            ++i; // skip separators and whitespace
+            continue;
+        }
+        b = a;
+        if( i < s.size() && s[i] == '-' )
+        {
+            ++i;
+            if( !number(b) )
+                b = a;
+        }
+        for(int c=a; c <= b; ++c)
+            cpus.push_back(c);
+    }
+    return cpus;
+}
+
+/**
+ * @brief The cpu_topology class
+ *
+ * The NUMA nodes of the machine and the cpus which belong to each, read
+ * from /sys/devices/system/node on Linux. Only the cpus the process is
+ * allowed to run on are listed. On other systems, or if the information
+ * is not available, there is a single node holding every cpu.
+ */
+class cpu_topology
+{
+public:
+    struct numa_node
+    {
+        int     id;
+        cpu_set cpus;
+    };
+
+    /**
+     * @brief get
+     * @return
+     *
+     * Returns the topology of the machine, discovered on first use.
+     */
+    static cpu_topology const & get()
+    {
+        static const cpu_topology t = discover("/sys/devices/system/node");
+        return t;
+    }
+
+    /**
+     * @brief discover
+     * @param root - the directory holding the node<N> directories
+     * @param allowed - the cpus to keep
+     * @return
+     *
+     * Reads the topology from root. Useful for testing with a fake
+     * directory tree.
+     */
+    static cpu_topology discover(std::string const & root, cpu_set const & allowed = allowed_cpus())
+    {
+        cpu_topology t;
+
+        for(int id=0; id < 1024; ++id)
+        {
+            std::ifstream f( root + "/node" + std::to_string(id) + "/cpulist" );
+            if( !f )
+                continue; // node ids may have gaps
+            std::string line;
+            std::getline(f, line);
+
+            numa_node n{ id, {} };
+            for(auto c : parse_cpu_list(line))
+            {
+                if( std::find(allowed.begin(), allowed.end(), c) != allowed.end() )
+                    n.cpus.push_back(c);
+            }
+            if( !n.cpus.empty() )
+                t.m_nodes.push_back( std::move(n) );
+        }
+
+        if( t.m_nodes.empty() )
+            t.m_nodes.push_back( numa_node{0, allowed} );
+        return t;
+    }
+
+    std::vector<numa_node> const & nodes() const
+    {
+        return m_nodes;
+    }
+
+    std::size_t num_nodes() const
+    {
+        return m_nodes.size();
+    }
+
+    /**
+     * @brief cpus
+     * @return
+     *
+     * Returns every cpu, ordered by node.
+     */
+    cpu_set cpus() const
+    {
+        cpu_set all;
+        for(auto & n : m_nodes)
+            all.insert(all.end(), n.cpus.begin(), n.cpus.end());
+        return all;
+    }
+
+    /**
+     * @brief node_of
+     * @param cpu
+     * @return
+     *
+     * Returns the index (in nodes()) of the node the cpu belongs to, or 0
+     * if it is not known.
+     */
+    std::size_t node_of(int cpu) const
+    {
+        for(std::size_t i=0; i < m_nodes.size(); ++i)
+        {
+            auto & c = m_nodes[i].cpus;
+            if( std::find(c.begin(), c.end(), cpu) != c.end() )
+                return i;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief allowed_cpus
+     * @return
+     *
+     * Returns the cpus the process may run on.
+     */
+    static cpu_set allowed_cpus()
+    {
+        cpu_set cpus;
+#if defined(__linux__)
+        cpu_set_t s;
+        CPU_ZERO(&s);
+        if( sched_getaffinity(0, sizeof(s), &s) == 0 )
+        {
+            for(int c=0; c < CPU_SETSIZE; ++c)
+            {
+                if( CPU_ISSET(c, &s) )
+                    cpus.push_back(c);
+            }
+        }
+#endif
+        if( cpus.empty() )
+        {
+            auto n = std::max(1u, std::thread::hardware_concurrency());
+            for(unsigned c=0; c < n; ++c)
+                cpus.push_back( static_cast<int>(c) );
+        }
+        return cpus;
+    }
+
+protected:
+    std::vector<numa_node> m_nodes;
+};
+
+/**
+ * @brief pin_this_thread
+ * @param cpus
+ * @return
+ *
+ * Restricts the calling thread to the given cpus. Returns false if the
+ * affinity could not be set, eg: on systems other than Linux.
+ */
+inline bool pin_this_thread(cpu_set const & cpus)
+{
+#if defined(__linux__)
+    if( cpus.empty() )
+        return false;
+    cpu_set_t s;
+    CPU_ZERO(&s);
+    for(auto c : cpus)
+    {
+        if( c >= 0 && c < CPU_SETSIZE )
+            CPU_SET(c, &s);
+    }
+    return sched_setaffinity(0, sizeof(s), &s) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+/**
+ * @brief this_thread_cpu
+ * @return
+ *
+ * Returns the cpu the calling thread is running on, or -1 if unknown.
+ */
+inline int this_thread_cpu()
+{
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+}
+#endif
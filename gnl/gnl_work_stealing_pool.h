@@ -0,0 +1,483 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+#include "gnl_task.h"
+
+#ifndef GNL_NAMESPACE
+    #define GNL_NAMESPACE gnl
+#endif
+namespace GNL_NAMESPACE
+{
+
+/**
+ * @brief The chase_lev_deque class
+ *
+ * A lock-free work-stealing deque (Chase and Lev, with the memory orderings of
+ * Le et al, "Correct and Efficient Work-Stealing for Weak Memory Models").
+ *
+ * Only the owning thread may call push() and pop(), which operate on the
+ * bottom of the deque. Any thread may call steal(), which takes from the top.
+ * The buffer grows when full. Old buffers are kept until the deque is
+ * destroyed since a thief may still be reading from them.
+ */
+class chase_lev_deque
+{
+    public:
+        using value_type = std::uintptr_t; // 0 is used to indicate "no value"
+
+        explicit chase_lev_deque(std::size_t capacity = 256);
+
+        void       push(value_type x);
+        value_type pop();
+        value_type steal();
+
+        /**
+         * @brief size
+         * @return
+         *
+         * Returns the approximate number of items in the deque
+         */
+        std::size_t size() const
+        {
+            auto b = m_bottom.load(std::memory_order_relaxed);
+            auto t = m_top.load(std::memory_order_relaxed);
+            return b > t ? static_cast<std::size_t>(b - t) : 0;
+        }
+
+    protected:
+        struct buffer
+        {
+            explicit buffer(std::int64_t cap) : capacity(cap), mask(cap-1), items(new std::atomic<value_type>[cap])
+            {
+            }
+
+            value_type get(std::int64_t i) const
+            {
+                return items[i & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(std::int64_t i, value_type x)
+            {
+                items[i & mask].store(x, std::memory_order_relaxed);
+            }
+
+            std::int64_t                                 capacity;
+            std::int64_t                                 mask;
+            std::unique_ptr< std::atomic<value_type>[] > items;
+        };
+
+        buffer * grow(buffer * a, std::int64_t b, std::int64_t t);
+
+        alignas(64) std::atomic<std::int64_t> m_top{0};
+        alignas(64) std::atomic<std::int64_t> m_bottom{0};
+        std::atomic<buffer*>                  m_buffer;
+        std::vector< std::unique_ptr<buffer> > m_buffers; // all buffers ever allocated, owned by the deque
+};
+
+/**
+ * @brief The work_stealing_pool class
+ *
+ * A thread pool where every worker owns a chase_lev_deque. Tasks pushed from
+ * a worker thread are placed on that worker's own deque and are executed
+ * LIFO, so a task spawned by another task will usually run on the same core
+ * while its data is still in cache. Tasks pushed from any other thread are
+ * placed on a shared injection queue. Idle workers steal from the top of a
+ * randomly chosen victim's deque.
+ *
+ * To use with graphe::threaded_executor, use a wrapper which calls push_ref()
+ * with the std::function passed to its () operator.
+ */
+class work_stealing_pool
+{
+    public:
+        explicit work_stealing_pool(std::size_t num_threads);
+        ~work_stealing_pool();
+
+        work_stealing_pool(work_stealing_pool const &) = delete;
+        work_stealing_pool & operator=(work_stealing_pool const &) = delete;
+
+        /**
+         * @brief push
+         * @param f
+         *
+         * Push a callable onto the pool. The callable is copied into a
+         * heap allocated std::function which is deleted once it has executed.
+         */
+        template<class F>
+        void push(F && f);
+
+        /**
+         * @brief push_ref
+         * @param f
+         *
+         * Push a reference to a std::function onto the pool. The function
+         * is not copied and must stay alive until it has executed. No memory
+         * is allocated.
+         */
+        void push_ref(std::function<void()> & f);
+
+        /**
+         * @brief num_workers
+         * @return
+         *
+         * Returns the number of workers in this thread pool
+         */
+        std::size_t num_workers() const { return m_workers.size(); }
+
+        /**
+         * @brief num_tasks
+         * @return
+         *
+         * Returns the approximate number of tasks waiting to be executed
+         */
+        std::size_t num_tasks();
+
+        /**
+         * @brief current_worker
+         * @return
+         *
+         * Returns the index of the worker which is calling this method, or -1
+         * if the calling thread is not one of this pool's workers.
+         */
+        int current_worker() const;
+
+    protected:
+        using task_handle = chase_lev_deque::value_type;
+
+        // The lowest bit of a task_handle indicates that the std::function
+        // it points to is owned by the pool.
+        static constexpr task_handle owned_bit = 1;
+
+        struct worker
+        {
+            chase_lev_deque      deque;
+            std::thread          thread;
+            work_stealing_pool * pool  = nullptr;
+            std::uint32_t        index = 0;
+            std::uint32_t        seed  = 0;
+        };
+
+        struct thread_state
+        {
+            worker * current = nullptr;
+        };
+
+        static thread_state & this_thread_state()
+        {
+            static thread_local thread_state s;
+            return s;
+        }
+
+        void        submit(task_handle h);
+        task_handle find_task(worker & w);
+        bool        has_work();
+        void        run(task_handle h);
+        void        work(worker & w);
+
+        std::vector< std::unique_ptr<worker> > m_workers;
+
+        std::mutex               m_inject_mutex;
+        ring_queue<task_handle>  m_inject;           // tasks pushed from outside the pool
+        std::atomic<std::size_t> m_inject_size{0};
+
+        std::mutex               m_sleep_mutex;
+        std::condition_variable  m_cv;
+        std::atomic<std::uint32_t> m_sleeping{0};     // number of workers waiting on m_cv
+        std::atomic<std::uint64_t> m_epoch{0};        // incremented every time a task is pushed
+        std::atomic<bool>        m_stop{false};
+};
+
+//=============================================================================
+// chase_lev_deque
+//=============================================================================
+inline chase_lev_deque::chase_lev_deque(std::size_t capacity)
+{
+    std::int64_t cap = 1;
+    while( cap < static_cast<std::int64_t>(capacity) ) cap <<= 1;
+
+    m_buffers.emplace_back( new buffer(cap) );
+    m_buffer.store( m_buffers.back().get(), std::memory_order_relaxed);
+}
+
+inline chase_lev_deque::buffer * chase_lev_deque::grow(buffer * a, std::int64_t b, std::int64_t t)
+{
+    auto * n = new buffer(a->capacity * 2);
+    for(auto i=t; i < b; ++i)
+    {
+        n->put(i, a->get(i));
+    }
+    m_buffers.emplace_back(n);
+    m_buffer.store(n, std::memory_order_release);
+    return n;
+}
+
+inline void chase_lev_deque::push(value_type x)
+{
+    auto b = m_bottom.load(std::memory_order_relaxed);
+    auto t = m_top.load(std::memory_order_acquire);
+    auto a = m_buffer.load(std::memory_order_relaxed);
+
+    if( b - t > a->capacity - 1 )
+    {
+        a = grow(a, b, t);
+    }
+    a->put(b, x);
+    m_bottom.store(b+1, std::memory_order_release); // publishes the item to the thieves
+}
+
+inline chase_lev_deque::value_type chase_lev_deque::pop()
+{
+    auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+    auto a = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = m_top.load(std::memory_order_relaxed);
+
+    value_type x = 0;
+    if( t <= b )
+    {
+        x = a->get(b);
+        if( t == b )
+        {
+            // last item, race against the thieves
+            if( !m_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed) )
+                x = 0;
+            m_bottom.store(b+1, std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        m_bottom.store(b+1, std::memory_order_relaxed);
+    }
+    return x;
+}
+
+inline chase_lev_deque::value_type chase_lev_deque::steal()
+{
+    auto t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = m_bottom.load(std::memory_order_acquire);
+
+    if( t < b )
+    {
+        auto a = m_buffer.load(std::memory_order_acquire);
+        auto x = a->get(t);
+        if( !m_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed) )
+            return 0; // lost the race
+        return x;
+    }
+    return 0;
+}
+
+//=============================================================================
+// work_stealing_pool
+//=============================================================================
+inline work_stealing_pool::work_stealing_pool(std::size_t num_threads)
+{
+    if( num_threads == 0 ) num_threads = 1;
+
+    for(std::size_t i=0; i < num_threads; ++i)
+    {
+        m_workers.emplace_back( new worker() );
+        m_workers.back()->pool  = this;
+        m_workers.back()->index = static_cast<std::uint32_t>(i);
+        m_workers.back()->seed  = static_cast<std::uint32_t>(i) * 2654435761u + 1u;
+    }
+    // start the threads only once all the deques exist since
+    // workers will try to steal from each other.
+    for(auto & w : m_workers)
+    {
+        worker * p = w.get();
+        w->thread = std::thread( [this,p]{ work(*p); } );
+    }
+}
+
+inline work_stealing_pool::~work_stealing_pool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for(auto & w : m_workers)
+    {
+        if( w->thread.joinable() )
+            w->thread.join();
+    }
+
+    // delete any owned tasks which were never executed
+    auto discard = [](task_handle h)
+    {
+        if( h & owned_bit )
+            delete reinterpret_cast< std::function<void()>* >(h & ~owned_bit);
+    };
+    for(auto & w : m_workers)
+    {
+        while( auto h = w->deque.pop() ) discard(h);
+    }
+    while( !m_inject.empty() ) discard( m_inject.pop() );
+}
+
+template<class F>
+void work_stealing_pool::push(F && f)
+{
+    auto * fn = new std::function<void()>( std::forward<F>(f) );
+    submit( reinterpret_cast<task_handle>(fn) | owned_bit );
+}
+
+inline void work_stealing_pool::push_ref(std::function<void()> & f)
+{
+    submit( reinterpret_cast<task_handle>(&f) );
+}
+
+inline int work_stealing_pool::current_worker() const
+{
+    auto w = this_thread_state().current;
+    return (w && w->pool == this) ? static_cast<int>(w->index) : -1;
+}
+
+inline std::size_t work_stealing_pool::num_tasks()
+{
+    std::size_t n = m_inject_size.load(std::memory_order_relaxed);
+    for(auto & w : m_workers)
+        n += w->deque.size();
+    return n;
+}
+
+inline void work_stealing_pool::submit(task_handle h)
+{
+    auto w = this_thread_state().current;
+    if( w && w->pool == this )
+    {
+        w->deque.push(h); // only the owner may push onto its deque
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_inject_mutex);
+        m_inject.push(h);
+        m_inject_size.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if( m_sleeping.load(std::memory_order_seq_cst) != 0 )
+    {
+        // take the lock so the notification cannot be lost between
+        // a worker's final check and its wait.
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_cv.notify_one();
+    }
+}
+
+inline work_stealing_pool::task_handle work_stealing_pool::find_task(worker & w)
+{
+    // 1. our own deque
+    if( auto h = w.deque.pop() )
+        return h;
+
+    // 2. steal from random victims
+    auto n = static_cast<std::uint32_t>(m_workers.size());
+    if( n > 1 )
+    {
+        for(std::uint32_t attempt=0; attempt < 2*n; ++attempt)
+        {
+            // xorshift32
+            w.seed ^= w.seed << 13;
+            w.seed ^= w.seed >> 17;
+            w.seed ^= w.seed << 5;
+            auto victim = w.seed % n;
+            if( victim == w.index ) continue;
+            if( auto h = m_workers[victim]->deque.steal() )
+                return h;
+        }
+    }
+
+    // 3. the injection queue
+    if( m_inject_size.load(std::memory_order_relaxed) != 0 )
+    {
+        std::unique_lock<std::mutex> lock(m_inject_mutex);
+        if( !m_inject.empty() )
+        {
+            auto h = m_inject.pop();
+            m_inject_size.fetch_sub(1, std::memory_order_relaxed);
+            return h;
+        }
+    }
+    return 0;
+}
+
+inline bool work_stealing_pool::has_work()
+{
+    if( m_inject_size.load(std::memory_order_seq_cst) != 0 )
+        return true;
+    for(auto & w : m_workers)
+    {
+        if( w->deque.size() != 0 )
+            return true;
+    }
+    return false;
+}
+
+inline void work_stealing_pool::run(task_handle h)
+{
+    auto * fn = reinterpret_cast< std::function<void()>* >(h & ~owned_bit);
+    if( h & owned_bit )
+    {
+        std::unique_ptr< std::function<void()> > owned(fn);
+        (*owned)();
+    }
+    else
+    {
+        (*fn)();
+    }
+}
+
+inline void work_stealing_pool::work(worker & w)
+{
+    this_thread_state().current = &w;
+
+    while( !m_stop.load(std::memory_order_relaxed) )
+    {
+        if( auto h = find_task(w) )
+        {
+            run(h);
+            continue;
+        }
+
+        // nothing found, try a few more times before going to sleep
+        bool found = false;
+        for(int i=0; i < 64 && !found; ++i)
+        {
+            std::this_thread::yield();
+            if( auto h = find_task(w) )
+            {
+                run(h);
+                found = true;
+            }
+        }
+        if( found ) continue;
+
+        auto epoch = m_epoch.load(std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(m_sleep_mutex);
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if( !has_work() )
+        {
+            m_cv.wait(lock, [&]{ return m_stop.load() || m_epoch.load(std::memory_order_seq_cst) != epoch; });
+        }
+        m_sleeping.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    this_thread_state().current = nullptr;
+}
+
+}
+#endif
@@ -0,0 +1,182 @@
+#pragma once
+
+#ifndef ALLOC_TRACKER_GRAPH_3_H
+#define ALLOC_TRACKER_GRAPH_3_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace graphe
+{
+
+/**
+ * @brief The allocation_tracker class
+ *
+ * Counts the allocations made by every thread of the process while
+ * tracking is active, eg: during a frame, to check that executing a
+ * graph does not allocate once it has reached its steady state.
+ *
+ * Allocations are only seen if the global operator new is replaced by
+ * the one defined in this header: define GRAPHE_TRACK_ALLOCATIONS before
+ * including it, in exactly one translation unit of the program.
+ *
+ *   allocation_tracker::begin();
+ *   Exec.execute();
+ *   Exec.wait();
+ *   G.reset();
+ *   auto n = allocation_tracker::end();
+ *
+ * In trap mode, the trap handler is called on every allocation while
+ * tracking is active. The default handler prints a message and aborts,
+ * so the allocation can be found in a debugger. Handlers must not
+ * allocate.
+ */
+class allocation_tracker
+{
+public:
+    using handler = void(*)(std::size_t size);
+
+    /**
+     * @brief begin
+     * @param trap - call the trap handler on every allocation
+     *
+     * Resets the count and starts counting allocations.
+     */
+    static void begin(bool trap = false)
+    {
+        s_count.store(0, std::memory_order_relaxed);
+        s_trap.store(trap, std::memory_order_relaxed);
+        s_active.store(true, std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief end
+     * @return
+     *
+     * Stops counting and returns the number of allocations made since begin().
+     */
+    static uint64_t end()
+    {
+        s_active.store(false, std::memory_order_seq_cst);
+        s_trap.store(false, std::memory_order_relaxed);
+        return s_count.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t count()
+    {
+        return s_count.load(std::memory_order_relaxed);
+    }
+
+    static bool is_active()
+    {
+        return s_active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief is_installed
+     * @return
+     *
+     * Returns true if the replacement operator new has been compiled into
+     * the program, ie: whether allocations can be seen at all.
+     */
+    static bool is_installed()
+    {
+        return s_installed.load(std::memory_order_relaxed);
+    }
+
+    static void set_trap_handler(handler h)
+    {
+        s_handler.store(h ? h : default_handler, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief on_allocate
+     * @param size
+     *
+     * Called by the replacement operator new for every allocation.
+     */
+    static void on_allocate(std::size_t size)
+    {
+        if( !s_active.load(std::memory_order_relaxed) )
+            return;
+        s_count.fetch_add(1, std::memory_order_relaxed);
+        if( s_trap.load(std::memory_order_relaxed) )
+            s_handler.load(std::memory_order_relaxed)(size);
+    }
+
+    static void default_handler(std::size_t size)
+    {
+        std::fprintf(stderr, "graphe::allocation_tracker: allocation of %zu bytes during a tracked frame\n", size);
+        std::abort();
+    }
+
+protected:
+    friend struct allocation_tracker_installer;
+
+    static inline std::atomic<bool>     s_installed{false};
+    static inline std::atomic<bool>     s_active{false};
+    static inline std::atomic<bool>     s_trap{false};
+    static inline std::atomic<uint64_t> s_count{0};
+    static inline std::atomic<handler>  s_handler{default_handler};
+};
+
+}
+
+#if defined(GRAPHE_TRACK_ALLOCATIONS)
+
+namespace graphe
+{
+struct allocation_tracker_installer
+{
+    allocation_tracker_installer()
+    {
+        allocation_tracker::s_installed.store(true, std::memory_order_relaxed);
+    }
+};
+static allocation_tracker_installer allocation_tracker_installed;
+}
+
+void * operator new(std::size_t n)
+{
+    graphe::allocation_tracker::on_allocate(n);
+    if( auto p = std::malloc( n ? n : 1 ) )
+        return p;
+    throw std::bad_alloc();
+}
+
+void * operator new(std::size_t n, std::align_val_t a)
+{
+    graphe::allocation_tracker::on_allocate(n);
+    auto align = static_cast<std::size_t>(a);
+    if( auto p = std::aligned_alloc(align, (std::max<std::size_t>(n, 1) + align - 1) / align * align) )
+        return p;
+    throw std::bad_alloc();
+}
+
+// The array forms are not replaced: the library's operator new[] and
+// operator delete[] call the scalar forms above, so array allocations are
+// still counted.
+//
+// Once one of these is inlined into a delete-expression, GCC pairs the free()
+// with the new-expression that produced the pointer and reports a mismatch it
+// cannot know the replaced operator new makes correct. The suppression covers
+// only these four definitions.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void * p) noexcept                                  { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept                     { std::free(p); }
+void operator delete(void * p, std::align_val_t) noexcept                { std::free(p); }
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept   { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,428 @@
+#pragma once
+
+#ifndef CORO_NODE_GRAPH_3_H
+#define CORO_NODE_GRAPH_3_H
+
+#include "node_graph.h"
+
+#if !defined(__cpp_impl_coroutine)
+    #error "graph-e/coro_node.h requires C++20 coroutines"
+#endif
+
+#include <coroutine>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <variant>
+
+namespace graphe
+{
+
+/**
+ * @brief The async_exec_node class
+ *
+ * An exec_node whose () operator is a coroutine. The coroutine is started
+ * on the thread which runs the node. When it suspends, the thread is
+ * released. Whatever it is waiting on calls resume() once it is ready,
+ * which hands the coroutine back to the executor through the graph's
+ * onSpawn callback, or resumes it on the calling thread if there is none
+ * (ie: the graph is not driven by one of the executors).
+ * The node finishes, and its outputs become available, when the
+ * coroutine returns.
+ */
+class async_exec_node : public exec_node
+{
+public:
+    explicit async_exec_node(std::pmr::memory_resource * memory) : exec_node(memory)
+    {
+        m_resume = [this]()
+        {
+            auto graph = m_Graph;
+            m_handle.resume();
+            graph->m_numSpawned.fetch_sub(1, std::memory_order_release);
+        };
+    }
+
+    ~async_exec_node() override
+    {
+        if( m_handle )
+            m_handle.destroy(); // the coroutine threw, or the node was destroyed while suspended
+    }
+
+    /**
+     * @brief resume
+     *
+     * Schedules the suspended coroutine to continue.
+     */
+    void resume()
+    {
+        auto graph = m_Graph;
+        // one count for the task, and one until onSpawn has returned: this
+        // thread is not part of the frame, so the frame may finish (and the
+        // executor be destroyed) before onSpawn returns
+        graph->m_numSpawned.fetch_add(2, std::memory_order_relaxed);
+        if( graph->onSpawn && graph->onSpawn(m_resume) )
+        {
+            graph->m_numSpawned.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        graph->m_numSpawned.fetch_sub(2, std::memory_order_relaxed);
+        m_handle.resume();
+    }
+
+protected:
+    friend struct node_task;
+
+    /**
+     * @brief complete
+     *
+     * Called when the coroutine has returned and its frame has been
+     * destroyed.
+     */
+    void complete()
+    {
+        finish_run();
+    }
+
+    std::coroutine_handle<>   m_handle;
+    std::function<void(void)> m_resume; // handed to the thread pool to resume the coroutine
+};
+
+/**
+ * @brief The node_task struct
+ *
+ * The return type of the () operator of a node added with
+ * node_graph::add_async_node().
+ *
+ *   graphe::node_task operator()()
+ *   {
+ *       co_await graphe::sleep_for( std::chrono::milliseconds(10) );
+ *       auto n = co_await m_read; // a graphe::completion<std::size_t>
+ *       out.set(n);
+ *   }
+ *
+ * An exception thrown by the coroutine propagates out of the thread
+ * which was running it, and the node never finishes, as with a regular
+ * node which throws.
+ */
+struct node_task
+{
+    struct promise_type
+    {
+        async_exec_node * node = nullptr;
+
+        node_task get_return_object()
+        {
+            return node_task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+
+        std::suspend_always initial_suspend() noexcept // started by async_exec_node_t::start()
+        {
+            return {};
+        }
+
+        struct final_awaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                auto N = h.promise().node;
+                N->m_handle = nullptr;
+                h.destroy();
+                N->complete();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception()
+        {
+            throw;
+        }
+    };
+
+    node_task(node_task && other) noexcept : m_handle(other.m_handle)
+    {
+        other.m_handle = nullptr;
+    }
+
+    node_task(node_task const &) = delete;
+
+    ~node_task()
+    {
+        if( m_handle )
+            m_handle.destroy(); // never started
+    }
+
+    /**
+     * @brief release
+     * @return
+     *
+     * Gives up ownership of the coroutine.
+     */
+    std::coroutine_handle<promise_type> release()
+    {
+        auto h = m_handle;
+        m_handle = nullptr;
+        return h;
+    }
+
+protected:
+    explicit node_task(std::coroutine_handle<promise_type> h) : m_handle(h)
+    {
+    }
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+using node_task_handle = std::coroutine_handle<node_task::promise_type>;
+
+/**
+ * @brief The async_exec_node_t class
+ *
+ * Stores an instance of Node_t inline. Node_t's () operator must return
+ * a node_task.
+ */
+template<typename Node_t>
+class async_exec_node_t : public async_exec_node
+{
+public:
+    explicit async_exec_node_t(std::pmr::memory_resource * memory) : async_exec_node(memory)
+    {
+    }
+
+    template<typename... _Args>
+    void construct(_Args&&... __args)
+    {
+        m_NodeClass = new (&m_storage) Node_t( std::forward<_Args>(__args)... );
+        m_start     = [](exec_node * N)
+        {
+            static_cast<async_exec_node_t*>(N)->start();
+        };
+    }
+
+    Node_t & get()
+    {
+        return *static_cast<Node_t*>(m_NodeClass);
+    }
+
+    ~async_exec_node_t() override
+    {
+        if( m_handle )
+        {
+            m_handle.destroy(); // before the Node the coroutine refers to
+            m_handle = nullptr;
+        }
+        if( m_NodeClass )
+            static_cast<Node_t*>(m_NodeClass)->~Node_t();
+    }
+
+protected:
+    void start()
+    {
+        auto h = get()().release();
+        h.promise().node = this;
+        m_handle = h;
+        h.resume(); // the node may have finished, or be running on another thread, once this returns
+    }
+
+    alignas(Node_t) unsigned char m_storage[sizeof(Node_t)];
+};
+
+/**
+ * @brief The timer_service class
+ *
+ * A single thread which resumes nodes suspended in sleep_for() or
+ * sleep_until() once their time has come.
+ */
+class timer_service
+{
+public:
+    static timer_service & instance()
+    {
+        static timer_service T;
+        return T;
+    }
+
+    void add(time_point when, async_exec_node * N)
+    {
+        {
+            std::lock_guard<std::mutex> L(m_lock);
+            m_timers.push( {when, N} );
+        }
+        m_cv.notify_one();
+    }
+
+    ~timer_service()
+    {
+        {
+            std::lock_guard<std::mutex> L(m_lock);
+            m_stop = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+    }
+
+protected:
+    struct timer
+    {
+        time_point        when;
+        async_exec_node * node;
+
+        bool operator<(timer const & o) const
+        {
+            return when > o.when; // earliest on top
+        }
+    };
+
+    timer_service() : m_thread( [this] { run(); } )
+    {
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        while( !m_stop )
+        {
+            if( m_timers.empty() )
+            {
+                m_cv.wait(lk);
+                continue;
+            }
+            auto t = m_timers.top();
+            if( clock::now() < t.when )
+            {
+                m_cv.wait_until(lk, t.when);
+                continue;
+            }
+            m_timers.pop();
+            lk.unlock();
+            t.node->resume();
+            lk.lock();
+        }
+    }
+
+    std::mutex                  m_lock;
+    std::condition_variable     m_cv;
+    std::priority_queue<timer>  m_timers;
+    bool                        m_stop = false;
+    std::thread                 m_thread; // last, so it starts once the rest is constructed
+};
+
+/**
+ * @brief The sleep_until struct
+ *
+ * Awaitable which suspends the node until the given time, without
+ * holding a thread.
+ */
+struct sleep_until
+{
+    time_point when;
+
+    bool await_ready() const noexcept
+    {
+        return clock::now() >= when;
+    }
+
+    void await_suspend(node_task_handle h) const
+    {
+        timer_service::instance().add(when, h.promise().node);
+    }
+
+    void await_resume() const noexcept {}
+};
+
+template<typename Rep, typename Period>
+sleep_until sleep_for(std::chrono::duration<Rep, Period> d)
+{
+    return sleep_until{ clock::now() + std::chrono::duration_cast<clock::duration>(d) };
+}
+
+/**
+ * @brief The completion class
+ *
+ * A one-shot event carrying a value, eg: the result of an asynchronous
+ * read, or a value produced by a node of another graph. The node
+ * co_awaits it, and whoever produces the value calls set(), from any
+ * thread. If set() was called first, co_await does not suspend.
+ *
+ *   graphe::completion<std::size_t> m_read;
+ *
+ *   m_read.reset();
+ *   start_read( [this](std::size_t n) { m_read.set(n); } );
+ *   auto n = co_await m_read;
+ *
+ * Call reset() before reusing it in the next frame.
+ */
+template<typename T = void>
+class completion
+{
+    using value_type = std::conditional_t< std::is_void_v<T>, std::monostate, T>;
+
+public:
+    completion() = default;
+    completion(completion const &) = delete;
+    completion & operator=(completion const &) = delete;
+
+    void reset()
+    {
+        m_value.reset();
+        m_node = nullptr;
+        m_state.store(empty, std::memory_order_relaxed);
+    }
+
+    template<typename... _Args>
+    void set(_Args&&... __args)
+    {
+        m_value.emplace( std::forward<_Args>(__args)... );
+        if( m_state.exchange(done, std::memory_order_acq_rel) == waiting )
+            m_node->resume();
+    }
+
+    bool is_set() const
+    {
+        return m_state.load(std::memory_order_acquire) == done;
+    }
+
+    bool await_ready() const noexcept
+    {
+        return is_set();
+    }
+
+    bool await_suspend(node_task_handle h)
+    {
+        m_node = h.promise().node;
+        uint32_t e = empty;
+        // if set() got there first, continue without suspending
+        return m_state.compare_exchange_strong(e, waiting, std::memory_order_acq_rel);
+    }
+
+    T await_resume()
+    {
+        if constexpr( !std::is_void_v<T> )
+            return std::move(*m_value);
+    }
+
+protected:
+    static constexpr uint32_t empty   = 0;
+    static constexpr uint32_t waiting = 1; // the node is suspended on this completion
+    static constexpr uint32_t done    = 2;
+
+    std::optional<value_type> m_value;
+    async_exec_node         * m_node = nullptr;
+    std::atomic<uint32_t>     m_state{empty};
+};
+
+}
+
+#endif
@@ -0,0 +1,376 @@
+#pragma once
+
+#ifndef MULTI_GRAPH_EXECUTE_GRAPH_3_H
+#define MULTI_GRAPH_EXECUTE_GRAPH_3_H
+
+#include "node_graph.h"
+#include "ready_queue.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace graphe
+{
+
+/**
+ * @brief The multi_graph_executor class
+ *
+ * Executes any number of independent graphs on one shared thread pool.
+ * Every graph keeps its own ready queue. When a worker is free, it takes
+ * a node from the graph which has received the least worker time relative
+ * to its weight (weighted fair queuing), skipping graphs which already
+ * have max_concurrency nodes running. Helpers of parallel nodes and
+ * resumed asynchronous nodes are queued and counted the same way. A
+ * graph with many ready nodes therefore cannot starve a graph with a few
+ * short ones.
+ *
+ *   multi_graph_executor<ThreadPoolWrapper> Exec;
+ *   Exec.set_thread_pool(&TW);
+ *
+ *   auto heavy = Exec.add_graph(G1, 1, 2); // weight 1, at most 2 nodes at once
+ *   auto light = Exec.add_graph(G2, 4);    // weight 4, no cap
+ *
+ *   auto f1 = Exec.execute(heavy);
+ *   auto f2 = Exec.execute(light);
+ *   f2.get(); // the light graph's frame has finished
+ *   G2.reset();
+ *
+ * The executor takes over the graphs' onSchedule, onComplete and onSpawn
+ * callbacks until they are removed. Inline continuation bypasses the
+ * ready queues, so it should be left disabled on the graphs.
+ */
+template<typename ThreadPool_t>
+class multi_graph_executor
+{
+public:
+    using graph_id = std::size_t;
+
+    multi_graph_executor()
+    {
+        m_run_next = [this]()
+        {
+            run_ready();
+            m_outstanding.fetch_sub(1, std::memory_order_release);
+        };
+    }
+
+    multi_graph_executor(multi_graph_executor const &) = delete;
+    multi_graph_executor & operator=(multi_graph_executor const &) = delete;
+
+    ~multi_graph_executor()
+    {
+        for(graph_id i=0; i < m_graphs.size(); ++i)
+        {
+            if( m_graphs[i] )
+                remove_graph(i);
+        }
+        while( m_outstanding.load(std::memory_order_acquire) != 0 )
+            std::this_thread::yield();
+    }
+
+    void set_thread_pool(ThreadPool_t * T)
+    {
+        m_thread_pool = T;
+    }
+
+    ThreadPool_t * get_thread_pool() const
+    {
+        return m_thread_pool;
+    }
+
+    /**
+     * @brief add_graph
+     * @param graph
+     * @param weight - share of the pool the graph gets when the pool is busy
+     * @param max_concurrency - maximum number of the graph's nodes running at once, 0 for no limit
+     * @return
+     *
+     * Adds a graph to the executor and returns the id used to execute it.
+     * The graph must outlive the executor, or be removed first.
+     */
+    graph_id add_graph(node_graph & graph, uint32_t weight = 1, uint32_t max_concurrency = 0)
+    {
+        auto E = std::make_unique<graph_entry>();
+        E->graph           = &graph;
+        E->weight          = std::max<uint32_t>(1, weight);
+        E->max_concurrency = max_concurrency;
+
+        auto e = E.get();
+        graph.setOnSchedule(
+        [this, e](exec_node * N)
+        {
+            {
+                std::lock_guard<std::mutex> L(m_lock);
+                wake(*e);
+                e->ready.push(N);
+            }
+            m_outstanding.fetch_add(1, std::memory_order_relaxed);
+            m_thread_pool->operator()(m_run_next);
+        });
+
+        graph.setOnComplete(
+        [e]()
+        {
+            auto p = std::move(e->done);
+            p.set_value();
+        });
+
+        graph.setOnSpawn(
+        [this, e](std::function<void(void)> & task)
+        {
+            // helpers of parallel nodes and resumed asynchronous nodes go
+            // through the graph's queue, so they count towards its
+            // concurrency limit and its worker time
+            {
+                std::lock_guard<std::mutex> L(m_lock);
+                wake(*e);
+                e->spawned.push(&task);
+            }
+            m_outstanding.fetch_add(1, std::memory_order_relaxed);
+            m_thread_pool->operator()(m_run_next);
+            return true;
+        });
+
+        std::lock_guard<std::mutex> L(m_lock);
+        for(graph_id i=0; i < m_graphs.size(); ++i)
+        {
+            if( !m_graphs[i] )
+            {
+                m_graphs[i] = std::move(E);
+                return i;
+            }
+        }
+        m_graphs.push_back( std::move(E) );
+        return m_graphs.size() - 1;
+    }
+
+    /**
+     * @brief remove_graph
+     * @param id
+     *
+     * Waits for the graph's current frame to finish, gives the graph its
+     * callbacks back and removes it from the executor.
+     */
+    void remove_graph(graph_id id)
+    {
+        std::unique_lock<std::mutex> L(m_lock);
+        auto & G = *entry(id).graph;
+        L.unlock();
+        G.wait();
+
+        L.lock();
+        // the worker which ran the last node may still be accounting for it
+        while( m_graphs[id]->running != 0 || G.get_num_spawned() != 0 )
+        {
+            L.unlock();
+            std::this_thread::yield();
+            L.lock();
+        }
+        G.clearOnSchedule();
+        G.clearOnComplete();
+        G.clearOnSpawn();
+        m_graphs[id].reset();
+    }
+
+    /**
+     * @brief execute
+     * @param id
+     * @return
+     *
+     * Starts a frame of the graph and returns a future which becomes
+     * ready when the frame has finished. As with the other executors,
+     * the graph must be reset() between frames.
+     */
+    std::future<void> execute(graph_id id)
+    {
+        graph_entry * e;
+        {
+            std::lock_guard<std::mutex> L(m_lock);
+            e = &entry(id);
+        }
+        auto & E = *e;
+        E.graph->wait(); // the previous frame may still be returning from onComplete
+
+        E.done = std::promise<void>();
+        auto f = E.done.get_future();
+        E.graph->trigger_all();
+        return f;
+    }
+
+    /**
+     * @brief wait
+     *
+     * Blocks until the current frame of every graph has finished.
+     */
+    void wait()
+    {
+        std::vector<node_graph*> graphs;
+        {
+            std::lock_guard<std::mutex> L(m_lock);
+            for(auto & E : m_graphs)
+            {
+                if( E )
+                    graphs.push_back(E->graph);
+            }
+        }
+        for(auto G : graphs)
+            G->wait();
+    }
+
+    void set_weight(graph_id id, uint32_t weight)
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        entry(id).weight = std::max<uint32_t>(1, weight);
+    }
+
+    uint32_t get_weight(graph_id id) const
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        return entry(id).weight;
+    }
+
+    /**
+     * @brief set_max_concurrency
+     * @param id
+     * @param n
+     *
+     * Limits the number of the graph's nodes which may run at the same
+     * time. 0 removes the limit.
+     */
+    void set_max_concurrency(graph_id id, uint32_t n)
+    {
+        {
+            std::lock_guard<std::mutex> L(m_lock);
+            entry(id).max_concurrency = n;
+        }
+        // nodes held back by the old limit may now be runnable
+        m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        m_thread_pool->operator()(m_run_next);
+    }
+
+    uint32_t get_max_concurrency(graph_id id) const
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        return entry(id).max_concurrency;
+    }
+
+protected:
+    struct graph_entry
+    {
+        node_graph             * graph = nullptr;
+        uint32_t                 weight = 1;
+        uint32_t                 max_concurrency = 0;
+        uint32_t                 running = 0;     // nodes taken from the queue which have not returned
+        int64_t                  vtime = 0;       // worker time received, in ns divided by the weight
+        int64_t                  avg_cost = 1000; // running average of a node's execution time, in ns
+        fifo_queue<exec_node*>   ready;
+        fifo_queue<std::function<void(void)>*> spawned; // helpers of parallel nodes and resumed asynchronous nodes
+        std::promise<void>       done;
+
+        bool has_work() const
+        {
+            return !ready.empty() || !spawned.empty();
+        }
+    };
+
+    graph_entry & entry(graph_id id) const
+    {
+        if( id >= m_graphs.size() || !m_graphs[id] )
+            throw std::out_of_range("Graph id does not exist in the executor");
+        return *m_graphs[id];
+    }
+
+    /**
+     * @brief wake
+     * @param E
+     *
+     * Called with the lock held before queuing work for E. An idle graph
+     * does not keep the credit it did not use, otherwise it could take
+     * the whole pool when it wakes up.
+     */
+    void wake(graph_entry & E)
+    {
+        if( !E.has_work() && E.running == 0 )
+            E.vtime = std::max(E.vtime, m_vclock);
+    }
+
+    /**
+     * @brief pick
+     * @return
+     *
+     * Returns the graph with queued work and spare concurrency which has
+     * received the least weighted worker time, or nullptr if there is
+     * none. Must be called with the lock held.
+     */
+    graph_entry * pick()
+    {
+        graph_entry * best = nullptr;
+        for(auto & E : m_graphs)
+        {
+            if( !E || !E->has_work() )
+                continue;
+            if( E->max_concurrency != 0 && E->running >= E->max_concurrency )
+                continue;
+            if( !best || E->vtime < best->vtime )
+                best = E.get();
+        }
+        return best;
+    }
+
+    /**
+     * @brief run_ready
+     *
+     * Runs nodes until no graph has a node which may run. The worker which
+     * returns a node keeps going, so a node held back by its graph's
+     * concurrency limit is run as soon as the limit allows it. Spawned
+     * tasks are run before ready nodes, as they belong to nodes which
+     * have already started.
+     */
+    void run_ready()
+    {
+        std::unique_lock<std::mutex> L(m_lock);
+        while( auto E = pick() )
+        {
+            exec_node                 * N = nullptr;
+            std::function<void(void)> * T = nullptr;
+            if( !E->spawned.empty() )
+                T = E->spawned.pop();
+            else
+                N = E->ready.pop();
+            ++E->running;
+
+            // charge the expected cost up front, so a graph with many ready
+            // nodes does not get every free worker before it is charged
+            m_vclock  = E->vtime;
+            auto est  = E->avg_cost;
+            E->vtime += est / E->weight;
+            L.unlock();
+
+            auto t0 = clock::now();
+            if( T )
+                (*T)();
+            else
+                N->run();
+            int64_t d = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count();
+
+            L.lock();
+            E->vtime   += (d - est) / E->weight;
+            E->avg_cost = std::max<int64_t>(1, (7 * E->avg_cost + d) / 8);
+            --E->running;
+        }
+    }
+
+    ThreadPool_t                              * m_thread_pool = nullptr;
+
+    mutable std::mutex                          m_lock;
+    std::vector< std::unique_ptr<graph_entry> > m_graphs; // indexed by graph_id, removed graphs are null
+    int64_t                                     m_vclock = 0; // vtime of the graph which was served last
+    std::atomic<uint32_t>                       m_outstanding{0}; // tasks handed to the pool which have not returned
+    std::function<void(void)>                   m_run_next;
+};
+
+}
+
+#endif
@@ -4,26 +4,42 @@
 #ifndef FRAME_GRAPH_3_H
 #define FRAME_GRAPH_3_H
 
+#include <cassert>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
 #include <functional>
 #include <thread>
 #include <algorithm>
 #include <map>
+#include <list>
+#include <unordered_map>
 #include <vector>
+#include <string>
+#include <string_view>
+#include <memory_resource>
 #include <queue>
-#include <any>
 #include <iostream>
 #include <type_traits>
+#include <typeinfo>
+#include <new>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 
 namespace graphe
 {
 
-using time_point = std::chrono::system_clock::time_point;
+using clock      = std::chrono::steady_clock; // monotonic, unlike system_clock
+using time_point = clock::time_point;
 
 class node_graph;
 class exec_node;
 class resource_node;
+class async_exec_node;
+struct resource_type;
+template<typename Node_t> class async_exec_node_t; // defined in coro_node.h
 using exec_node_p     = std::shared_ptr<exec_node>;
 using resource_node_p = std::shared_ptr<resource_node>;
 using exec_node_w      = std::weak_ptr<exec_node>;
@@ -45,846 +61,3582 @@ enum class resource_flags
 };
 
 /**
- * @brief The exec_node class
+ * @brief The node_stats class
  *
- * An exec_node is a node that executes some kind of computation.
+ * Rolling execution statistics of an exec_node. The total number of
+ * executions is counted, while the mean, min, max and percentiles are
+ * computed over the last window_size executions.
  */
-class exec_node
+class node_stats
 {
-protected:
-    friend class node_graph;
-    friend class ResourceRegistry;
+public:
+    static constexpr std::size_t window_size = 128;
 
-    std::string  m_name;
-    std::any     m_NodeClass;                      // an instance of the Node class
-    std::any     m_NodeData;                       // an instance of the node data
-    std::mutex   m_mutex;                          // mutex to prevent the node from executing twice
-    bool         m_scheduled = false;              // has this node been scheduled to run.
-    bool         m_executed = false;               // flag to indicate whether the node has been executed.
-    node_graph * m_Graph; // the parent graph;
+    /**
+     * @brief reserve
+     *
+     * Allocates the window so that record() never allocates.
+     */
+    void reserve()
+    {
+        m_window.reserve(window_size);
+    }
 
-    time_point     m_exec_start_time_us;            // the time at which this node was executed
+    void record(std::chrono::nanoseconds d)
+    {
+        if( m_window.size() < window_size )
+            m_window.push_back( d.count() );
+        else
+            m_window[ m_count % window_size ] = d.count();
+        ++m_count;
+    }
 
-    std::thread::id m_thread_id;                  // the id of the thread that executed this.
+    void clear()
+    {
+        m_window.clear();
+        m_count = 0;
+    }
 
-    node_flags   m_flags;
-    std::vector<resource_node_w> m_requiredResources; // a list of required resources
-    std::vector<resource_node_w> m_producedResources; // a list of required resources
+    /**
+     * @brief count
+     * @return
+     *
+     * Returns the total number of recorded executions
+     */
+    uint64_t count() const
+    {
+        return m_count;
+    }
 
+    std::chrono::nanoseconds mean() const
+    {
+        if( m_window.empty() ) return std::chrono::nanoseconds(0);
+        int64_t sum = 0;
+        for(auto x : m_window) sum += x;
+        return std::chrono::nanoseconds( sum / static_cast<int64_t>(m_window.size()) );
+    }
 
-public:
-    std::function<void(void)> execute; // Function object to execute the Node's () operator.
+    std::chrono::nanoseconds min() const
+    {
+        if( m_window.empty() ) return std::chrono::nanoseconds(0);
+        return std::chrono::nanoseconds( *std::min_element(m_window.begin(), m_window.end()) );
+    }
 
+    std::chrono::nanoseconds max() const
+    {
+        if( m_window.empty() ) return std::chrono::nanoseconds(0);
+        return std::chrono::nanoseconds( *std::max_element(m_window.begin(), m_window.end()) );
+    }
 
-    ~exec_node()
+    /**
+     * @brief percentile
+     * @param p - between 0 and 1
+     * @return
+     *
+     * Returns the p'th percentile (nearest rank) of the window.
+     */
+    std::chrono::nanoseconds percentile(double p) const
     {
-    //    std::cout << "Node Destroyed: " << m_name << std::endl;
+        if( m_window.empty() ) return std::chrono::nanoseconds(0);
+        auto w = m_window;
+        auto k = static_cast<std::size_t>( p * static_cast<double>(w.size()-1) + 0.5 );
+        std::nth_element(w.begin(), w.begin() + k, w.end());
+        return std::chrono::nanoseconds( w[k] );
     }
 
-    time_point get_time() const
+    std::chrono::nanoseconds p50() const { return percentile(0.50); }
+    std::chrono::nanoseconds p99() const { return percentile(0.99); }
+
+protected:
+    std::vector<int64_t> m_window; // durations in nanoseconds
+    uint64_t             m_count = 0;
+};
+
+/**
+ * @brief The node_cache class
+ *
+ * A least recently used store of the outputs of an exec_node, keyed by a
+ * hash of the values of its inputs. When a node whose cache holds an entry
+ * for its current inputs is executed, the outputs are copied from the
+ * entry and the node's () operator is not called.
+ *
+ * Entries are allocated from the default heap, not the graph's arena, so
+ * that evicted entries are freed. Two sets of inputs whose 64-bit hashes
+ * collide are treated as equal.
+ */
+class node_cache
+{
+public:
+    struct stats
+    {
+        uint64_t    hits      = 0;
+        uint64_t    misses    = 0;
+        uint64_t    evictions = 0;
+        std::size_t entries   = 0;
+        std::size_t bytes     = 0; // estimated size of the stored outputs
+    };
+
+    explicit node_cache(std::size_t max_bytes) : m_max_bytes(max_bytes)
     {
-        return m_exec_start_time_us;
     }
 
-    std::chrono::microseconds get_time(time_point start) const
+    node_cache(node_cache const &) = delete;
+    node_cache & operator=(node_cache const &) = delete;
+
+    ~node_cache()
     {
-        return std::chrono::duration_cast<std::chrono::microseconds>(m_exec_start_time_us-start);
+        clear();
+        discard_pending();
     }
+
     /**
-     * @brief trigger
+     * @brief lookup
+     * @param key
      *
-     * Nudge the exec_node to check whether all its resource are available. If it is available
-     * execute the call
+     * Copies the outputs stored for key back into their resources and
+     * returns true, or returns false if there is no such entry.
      */
-    void trigger();
+    bool lookup(uint64_t key);
 
     /**
-     * @brief can_execute
-     * @return
+     * @brief snapshot
+     * @param R
      *
-     * Returns true if this node is able to execute. A node is able to execute if
-     * all it's required resources have been made available.
+     * Copies the value of an output of the running node into the pending
+     * entry. Called when the output is published, before its dependents
+     * are notified, as they may modify or destroy it.
+     */
+    void snapshot(resource_node * R);
+
+    /**
+     * @brief store
+     * @param key
+     * @param num_outputs
+     *
+     * Moves the pending entry into the cache as the entry for key, evicting
+     * the least recently used entries until it fits in the budget. The
+     * pending entry is dropped if it does not hold all num_outputs outputs,
+     * or is larger than the whole budget.
+     */
+    void store(uint64_t key, std::size_t num_outputs);
+
+    /**
+     * @brief discard_pending
+     *
+     * Drops the values copied by snapshot().
      */
-    bool can_execute() const;
+    void discard_pending();
+
+    void clear();
 
-    const std::string & get_name() const
+    stats const & get_stats() const
     {
-        return m_name;
+        return m_stats;
     }
 
-    void set_name(const std::string & name) {
-        m_name = name;
+    std::size_t get_max_bytes() const
+    {
+        return m_max_bytes;
     }
 
-    node_flags get_flags() const
+protected:
+    friend class exec_node;
+
+    struct value
     {
-        return m_flags;
-    }
+        resource_node        * resource;
+        resource_type const  * type;
+        void                 * data;
+    };
 
+    struct entry
+    {
+        uint64_t           key;
+        std::size_t        bytes;
+        std::vector<value> values;
+    };
+
+    void erase(std::list<entry>::iterator it);
+    static void free_value(value & v);
+
+    std::size_t                                               m_max_bytes;
+    std::list<entry>                                          m_lru;   // most recently used first
+    std::unordered_map<uint64_t, std::list<entry>::iterator>  m_index;
+    stats                                                     m_stats;
+    entry                                                     m_pending{0, 0, {}}; // outputs published by the running node
+
+    uint64_t m_key  = 0;      // key of the inputs the node is running with
+    bool     m_miss = false;  // the outputs should be stored when the node finishes
 };
 
 /**
- * @brief The resource_node class
- * A resource node is a node which holds a resource and is created or consumed by an exec_node.
+ * @brief The exec_node class
  *
- * An exec_node is executed when all it's required resources have become available.
+ * An exec_node is a node that executes some kind of computation.
  */
-class resource_node
+class exec_node
 {
 protected:
-    friend class ResourceRegistry;
+    /**
+     * @brief run_once
+     *
+     * Executes this node only, without running any continuation.
+     */
+    void run_once();
 
-    std::any                 m_resource;
-    std::string              m_name;
-    std::vector<exec_node_w> m_Nodes; // list of nodes that must be triggered
-                                     // when resource becomes availabe
-    bool                     m_is_available = false;
-    resource_flags           m_flags;
+    /**
+     * @brief finish_run
+     *
+     * Called once the Node class has finished executing: records the end
+     * time and makes the outputs available.
+     */
+    void finish_run();
 
-    exec_node_w              m_parent;
-public:
-    time_point m_time_available;
+    /**
+     * @brief inputs_unchanged
+     *
+     * Returns true if the node has run before, none of its inputs has been
+     * changed since, and all its outputs still hold a value, ie: running
+     * it again would produce the same outputs. Nodes without inputs
+     * always run.
+     */
+    bool inputs_unchanged() const;
 
-    ~resource_node()
-    {
+    /**
+     * @brief record_inputs
+     *
+     * Stores the revisions of the inputs the node is about to run with.
+     */
+    void record_inputs();
 
-    }
+    /**
+     * @brief skip
+     *
+     * Completes the node without running it, making its previous outputs
+     * available again without marking them as changed.
+     */
+    void skip();
 
     /**
-     * @brief make_available
-     * @param av
+     * @brief release_inputs
      *
-     * Makes the resource available to other nodes. If this resource is needed by another node, that node
-     * will be scheduled for execution so long as all other required resources are satisfied
+     * Called once the node has finished with its inputs. Destroys the
+     * transient inputs it was the last consumer of, and lets the node
+     * whose outputs reuse their storage start.
      */
-    void make_available(bool av = true)
+    void release_inputs();
+
+    /**
+     * @brief cache_lookup
+     *
+     * Hashes the inputs and, if the node's cache holds their outputs,
+     * restores them and completes the node. Returns true if the node
+     * was completed.
+     */
+    bool cache_lookup();
+
+    /**
+     * @brief cache_snapshot
+     *
+     * Copies an output of a node which missed the cache into the cache's
+     * pending entry. Called by resource_node::publish() before the
+     * output's dependents are notified.
+     */
+    void cache_snapshot(resource_node * R);
+
+    /**
+     * @brief cache_store
+     *
+     * Stores the outputs copied by cache_snapshot() once the node has
+     * finished.
+     */
+    void cache_store();
+
+    template<typename F>
+    void for_each_input(F && f) const;
+    template<typename F>
+    void for_each_output(F && f) const;
+
+    friend class node_graph;
+    friend class resource_node;
+    friend class ResourceRegistry;
+    template<typename> friend class pipelined_executor;
+
+    std::pmr::memory_resource * m_memory;          // memory resource of the parent graph
+    std::string       m_name;
+    void       * m_NodeClass = nullptr;            // the instance of the Node class, stored inside the exec_node
+    void      (* m_invoke)(void*) = nullptr;       // calls the Node class's () operator
+    bool         m_parallel = false;               // this is a parallel_exec_node
+    void      (* m_start)(exec_node*) = nullptr;   // asynchronous nodes: starts the node, which calls
+                                                   // finish_run() itself once it has finished
+    std::atomic<bool>     m_scheduled{false};      // has this node been scheduled to run.
+    std::atomic<bool>     m_executed{false};       // flag to indicate whether the node has been executed.
+    std::atomic<uint32_t> m_pending{0};            // number of required resources which are not yet available
+    std::atomic<uint32_t> m_initial_pending{0};    // value m_pending is restored to on reset(). Required resources
+                                                   // which are permanent and available are not counted.
+    node_graph * m_Graph; // the parent graph;
+
+    time_point     m_exec_start_time_us;            // the time at which this node was executed
+    time_point     m_exec_end_time_us;              // the time at which this node finished executing
+
+    std::thread::id m_thread_id;                  // the id of the thread that executed this.
+
+    node_flags   m_flags;
+    std::pmr::vector<resource_node_w> m_requiredResources; // a list of required resources
+    std::pmr::vector<resource_node_w> m_producedResources; // a list of required resources
+
+    uint32_t     m_index = 0;                     // index of this node in the compiled plan
+    uint64_t     m_cost_ns = 0;                   // estimated execution time, 0 if unknown
+    uint64_t     m_priority = 0;                  // estimated time from the start of this node to the end of the graph
+    node_stats   m_stats;                         // only recorded when the graph's profiling is enabled
+
+    bool         m_incremental = true;            // may be skipped when the graph is incremental
+    bool         m_has_run = false;               // m_input_revisions holds the revisions of the last run
+    std::pmr::vector<uint64_t> m_input_revisions; // revisions of the inputs the last time the node ran, reserved by add_exec_node()
+
+    std::unique_ptr<node_cache> m_cache;          // null unless enable_cache() has been called
+    int          m_numa_node = -1;                // preferred NUMA node, -1 for any
+    uint32_t     m_alias_waits = 0;               // transient resources which must be released before the node's
+                                                  // outputs can reuse their storage. Counted in m_pending.
+
+
+public:
+    std::function<void(void)> execute; // Function object to execute the Node's () operator.
+                                       // Simply calls run(). Used by thread pools.
+
+    explicit exec_node(std::pmr::memory_resource * memory = std::pmr::get_default_resource()) :
+        m_memory(memory),
+        m_requiredResources(memory),
+        m_producedResources(memory),
+        m_input_revisions(memory)
     {
-        m_is_available = av;
-        m_time_available = std::chrono::system_clock::now();
     }
 
-    resource_flags get_flags() const
+    virtual ~exec_node()
     {
-        return m_flags;
+    //    std::cout << "Node Destroyed: " << m_name << std::endl;
     }
 
     /**
-     * @brief is_available
-     * @return
+     * @brief run
      *
-     * Returns true if this resource is available
+     * Executes the node, if it has not already been executed. Calls the Node
+     * class's () operator through a plain function pointer.
+     *
+     * If inline continuation is enabled on the graph, the first dependent
+     * which becomes ready while this node runs is executed on this
+     * thread after the node returns, instead of being scheduled.
      */
-    bool is_available() const
-    {
-        return m_is_available;
-    }
+    void run();
 
     time_point get_time() const
     {
-        return m_time_available;
+        return m_exec_start_time_us;
     }
+
     std::chrono::microseconds get_time(time_point start) const
     {
-        return std::chrono::duration_cast<std::chrono::microseconds>(m_time_available-start);
+        return std::chrono::duration_cast<std::chrono::microseconds>(m_exec_start_time_us-start);
     }
 
     /**
-     * @brief get_resource
+     * @brief get_thread_id
      * @return
      *
-     * Gets a reference to the resource.
+     * Returns the id of the thread which last executed this node.
      */
-    std::any & get_resource()
+    std::thread::id get_thread_id() const
     {
-        return m_resource;
+        return m_thread_id;
     }
 
-    bool has_parent() const
+    /**
+     * @brief get_duration
+     * @return
+     *
+     * Returns how long the node took to execute the last time it was executed
+     */
+    std::chrono::nanoseconds get_duration() const
     {
-        return m_parent.lock()!=nullptr;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(m_exec_end_time_us - m_exec_start_time_us);
     }
+
     /**
-     * @brief Get
+     * @brief get_stats
      * @return
      *
-     * Gets a reference to the resource cast to the particular type. Throws an
-     * exception of the resource has not been created
+     * Returns the execution statistics of the node. Only recorded
+     * while profiling is enabled on the graph.
      */
-    template<typename T>
-    T & Get()
+    node_stats const & get_stats() const
     {
-        return std::any_cast<T&>(m_resource);
+        return m_stats;
     }
 
-    std::string const & get_name() const
+    /**
+     * @brief set_cost
+     * @param t
+     *
+     * Sets the estimated execution time of the node. This is used to
+     * compute the node's priority when the graph is compiled.
+     */
+    void set_cost(std::chrono::nanoseconds t)
     {
-        return m_name;
+        m_cost_ns = static_cast<uint64_t>(t.count());
     }
 
     /**
-     * @brief notify_dependents
+     * @brief get_priority
+     * @return
      *
-     * Notify all nodes waiting on this resource that this resource is available.
+     * Returns the length of the longest path (in estimated nanoseconds)
+     * from the start of this node to the end of the graph. Computed by
+     * node_graph::compile() and node_graph::update_priorities().
      */
-    void notify_dependents()
+    uint64_t get_priority() const
     {
-        for(auto & N : m_Nodes)
-        {
-            if( auto n = N.lock())
-                n->trigger();
-        }
+        return m_priority;
     }
-};
-std::vector<int> x;
-
-//===============================================================================
-template<typename T> struct is_shared_ptr : std::false_type {};
-template<typename T> struct is_shared_ptr<std::shared_ptr<T>> : std::true_type {};
-//===============================================================================
-/**
- * @brief The in_resource class
- *
- * Class used to register an input resource.
- */
-template<typename T>
-class in_resource
-{
-    static constexpr bool is_fundamental = std::is_fundamental<T>::value;
-    static constexpr bool is_pointer_type  = (std::is_pointer<T>::value || is_shared_ptr<T>::value);
-
-protected:
-    friend class ResourceRegistry;
-    resource_node_w m_node;
-public:
+    /**
+     * @brief trigger
+     *
+     * Nudge the exec_node to check whether all its resource are available. If it is available
+     * execute the call. The node is scheduled at most once per execution of the graph.
+     */
+    void trigger();
 
     /**
-     * @brief get
+     * @brief can_execute
      * @return
      *
-     * Gets a reference to the resource.
+     * Returns true if this node is able to execute. A node is able to execute if
+     * all it's required resources have been made available.
      */
-    T & get()
+    bool can_execute() const
     {
-        return m_node.lock()->Get<T>();
+        return m_pending.load(std::memory_order_acquire) == 0;
     }
 
+    /**
+     * @brief resource_available
+     * @param permanent - true if the resource will never be reset.
+     *
+     * Called when one of the required resources becomes available. Decrements the
+     * pending counter and schedules the node once it reaches zero.
+     */
+    void resource_available(bool permanent);
 
-    //============================================================================
-    // Allows dereferencing if T is a fundamental type:
-    //============================================================================
-    T & operator*()
+    /**
+     * @brief check_outputs
+     *
+     * Throws an exception if any of the resources this node produces
+     * have not been made available.
+     */
+    void check_outputs() const;
+
+    uint32_t get_index() const
     {
-        return get();
+        return m_index;
     }
 
-    //============================================================================
-    // Allows allow using -> if T is a pointer
-    //============================================================================
-    template< typename U=T >
-    typename std::enable_if< std::is_same<T,U>::value && is_pointer_type, U&>::type
-    operator->()
+    std::string const & get_name() const
     {
-        return get();
+        return m_name;
     }
 
+    std::string_view name_view() const
+    {
+        return m_name;
+    }
 
-    template<
-    typename U = T,
-    typename = typename std::enable_if< std::is_same<T,U>::value >::type>
-    operator U() {
-        return get();
+    void set_name(const std::string & name) {
+        m_name = name;
     }
 
-};
+    /**
+     * @brief set_incremental
+     * @param enable
+     *
+     * When the graph is incremental, nodes whose inputs have not changed
+     * are skipped. Disable this for nodes which must run every frame,
+     * eg: because they have side effects.
+     */
+    void set_incremental(bool enable)
+    {
+        m_incremental = enable;
+    }
 
-/**
- * @brief The out_resource class
+    bool is_incremental() const
+    {
+        return m_incremental;
+    }
+
+    /**
+     * @brief set_numa_node
+     * @param node - index of the NUMA node, -1 for any
+     *
+     * Hints which NUMA node the node should execute on. The hint is passed
+     * to the thread pool by executors whose thread pool wrapper accepts
+     * it, see threaded_executor. It only affects scheduling: the storage
+     * of the node's resources is allocated when the graph is built and is
+     * not moved.
+     */
+    void set_numa_node(int node)
+    {
+        m_numa_node = node;
+    }
+
+    int get_numa_node() const
+    {
+        return m_numa_node;
+    }
+
+    /**
+     * @brief enable_cache
+     * @param max_bytes - the budget of the cache, in estimated bytes of stored outputs
+     *
+     * Memoizes the node: its outputs are stored, keyed by a hash of its
+     * inputs, and when the node is executed with inputs it has seen before
+     * its outputs are restored from the cache instead of calling its ()
+     * operator. Only use this for nodes which are pure functions of their
+     * inputs. Every input type must be hashable with std::hash and every
+     * output type copy constructible, otherwise an exception is thrown.
+     * Not used by the pipelined_executor.
+     */
+    void enable_cache(std::size_t max_bytes);
+
+    void disable_cache()
+    {
+        m_cache.reset();
+    }
+
+    /**
+     * @brief clear_cache
+     *
+     * Removes all the entries of the cache. The counters are kept.
+     */
+    void clear_cache()
+    {
+        if( m_cache )
+            m_cache->clear();
+    }
+
+    /**
+     * @brief get_cache_stats
+     * @return
+     *
+     * Returns the hit, miss and eviction counters of the cache.
+     */
+    node_cache::stats get_cache_stats() const
+    {
+        return m_cache ? m_cache->get_stats() : node_cache::stats{};
+    }
+
+    node_flags get_flags() const
+    {
+        return m_flags;
+    }
+
+};
+
+/**
+ * @brief The exec_node_t class
  *
- * Class for outgoing resources.
+ * An exec_node which stores an instance of Node_t inline. The instance
+ * is constructed by node_graph once the exec_node exists, since the
+ * Node's constructor needs to register its resources with it.
+ */
+template<typename Node_t>
+class exec_node_t : public exec_node
+{
+public:
+    explicit exec_node_t(std::pmr::memory_resource * memory) : exec_node(memory)
+    {
+    }
+
+    template<typename... _Args>
+    void construct(_Args&&... __args)
+    {
+        m_NodeClass = new (&m_storage) Node_t( std::forward<_Args>(__args)... );
+        m_invoke    = [](void * p)
+        {
+            (*static_cast<Node_t*>(p))();
+        };
+    }
+
+    Node_t & get()
+    {
+        return *static_cast<Node_t*>(m_NodeClass);
+    }
+
+    ~exec_node_t() override
+    {
+        if( m_NodeClass )
+            static_cast<Node_t*>(m_NodeClass)->~Node_t();
+    }
+
+protected:
+    alignas(Node_t) unsigned char m_storage[sizeof(Node_t)];
+};
+
+/**
+ * @brief The parallel_exec_node class
+ *
+ * An exec_node whose work is split into chunks of a range. When started,
+ * it hands helper tasks to the graph's onSpawn callback (if any) and
+ * executes chunks itself until none are left. Chunks are claimed through
+ * a single atomic counter, and whichever thread finishes the last chunk
+ * completes the node, so its outputs only become available once every
+ * chunk has run.
  */
+class parallel_exec_node : public exec_node
+{
+public:
+    explicit parallel_exec_node(std::pmr::memory_resource * memory) : exec_node(memory)
+    {
+        m_parallel = true;
+    }
+
+    std::function<void(void)> help; // Function object handed to thread pools to execute
+                                    // chunks of this node.
+
+protected:
+    friend class exec_node;
+    friend class node_graph;
+    template<typename> friend class pipelined_executor;
+
+    /**
+     * @brief start
+     *
+     * Splits the range into chunks, spawns the helpers and executes chunks
+     * on the calling thread. Does not wait for the helpers.
+     */
+    void start();
+
+    /**
+     * @brief run_chunks
+     *
+     * Claims and executes chunks until there are none left.
+     */
+    void run_chunks();
+
+    /**
+     * @brief finish
+     *
+     * Called after the last chunk: calls the Node class's finish(), makes
+     * every output which holds a value available, then completes the node.
+     */
+    void finish();
+
+    /**
+     * @brief run_inline
+     *
+     * Executes every chunk on the calling thread and publishes the outputs,
+     * without completing the node.
+     */
+    void run_inline();
+
+    /**
+     * @brief publish_outputs
+     *
+     * Calls the Node class's finish() and makes every output which holds
+     * a value available.
+     */
+    void publish_outputs();
+
+    void        (* m_prepare)(void*)                         = nullptr; // optional
+    std::size_t (* m_size)(void*)                            = nullptr;
+    std::size_t (* m_chunk_size)(void*)                      = nullptr;
+    void        (* m_invoke_range)(void*, std::size_t, std::size_t) = nullptr;
+    void        (* m_finish)(void*)                          = nullptr; // optional
+
+    // The number of chunks is stored in the high 32 bits and the next chunk
+    // to claim in the low 32 bits, so a single fetch_add claims a chunk and
+    // reads the bound. start() sets the range before it re-publishes
+    // m_claim with a release store, which also discards the claims of the
+    // previous execution. A helper left over from that execution therefore
+    // either finds every chunk claimed, or claims a chunk of the current
+    // execution and runs it with the current range: a stale claim is
+    // harmless.
+    std::atomic<uint64_t> m_claim{0};
+    std::atomic<uint32_t> m_chunks_left{0};
+    std::size_t           m_range_size  = 0;
+    std::size_t           m_range_chunk = 1;
+};
+
+template<typename T, typename = void>
+struct has_prepare : std::false_type {};
 template<typename T>
-class out_resource
+struct has_prepare<T, std::void_t<decltype( std::declval<T&>().prepare() )> > : std::true_type {};
+
+template<typename T, typename = void>
+struct has_finish : std::false_type {};
+template<typename T>
+struct has_finish<T, std::void_t<decltype( std::declval<T&>().finish() )> > : std::true_type {};
+
+/**
+ * @brief The parallel_exec_node_t class
+ *
+ * Stores an instance of Node_t inline. Node_t must provide:
+ *
+ *   std::size_t size();                                 // the number of items to process
+ *   std::size_t chunk_size();                           // the number of items per chunk
+ *   void operator()(std::size_t begin, std::size_t end); // process items [begin, end)
+ *
+ * and may provide:
+ *
+ *   void prepare(); // called before size(), eg: to emplace the outputs
+ *   void finish();  // called once after the last chunk
+ */
+template<typename Node_t>
+class parallel_exec_node_t : public parallel_exec_node
+{
+public:
+    explicit parallel_exec_node_t(std::pmr::memory_resource * memory) : parallel_exec_node(memory)
+    {
+    }
+
+    template<typename... _Args>
+    void construct(_Args&&... __args)
+    {
+        m_NodeClass    = new (&m_storage) Node_t( std::forward<_Args>(__args)... );
+        if constexpr( has_prepare<Node_t>::value )
+            m_prepare  = [](void * p) { static_cast<Node_t*>(p)->prepare(); };
+        if constexpr( has_finish<Node_t>::value )
+            m_finish   = [](void * p) { static_cast<Node_t*>(p)->finish(); };
+        m_size         = [](void * p) -> std::size_t { return static_cast<Node_t*>(p)->size(); };
+        m_chunk_size   = [](void * p) -> std::size_t { return static_cast<Node_t*>(p)->chunk_size(); };
+        m_invoke_range = [](void * p, std::size_t b, std::size_t e)
+        {
+            (*static_cast<Node_t*>(p))(b, e);
+        };
+    }
+
+    Node_t & get()
+    {
+        return *static_cast<Node_t*>(m_NodeClass);
+    }
+
+    ~parallel_exec_node_t() override
+    {
+        if( m_NodeClass )
+            static_cast<Node_t*>(m_NodeClass)->~Node_t();
+    }
+
+protected:
+    alignas(Node_t) unsigned char m_storage[sizeof(Node_t)];
+};
+
+template<typename T, typename = void>
+struct has_std_hash : std::false_type {};
+template<typename T>
+struct has_std_hash<T, std::void_t<decltype( std::hash<T>{}( std::declval<T const&>() ) )> > : std::true_type {};
+
+template<typename T, typename = void>
+struct is_contiguous_container : std::false_type {};
+template<typename T>
+struct is_contiguous_container<T, std::void_t<decltype( std::declval<T const&>().data() ),
+                                              decltype( std::declval<T const&>().size() ),
+                                              typename T::value_type> > : std::true_type {};
+
+/**
+ * @brief The resource_hash struct
+ *
+ * Specialize for a type to make resources of that type hashable, eg: so
+ * that they can be the inputs of a memoized node.
+ *
+ *   template<>
+ *   struct graphe::resource_hash<Mesh>
+ *   {
+ *       std::size_t operator()(Mesh const & m) const { return m.content_hash(); }
+ *   };
+ *
+ * Types without a specialization are hashed with std::hash, or, if they
+ * are contiguous containers of trivially copyable elements (eg:
+ * std::vector<float>), by the bytes of their elements.
+ */
+template<typename T>
+struct resource_hash {};
+
+template<typename T, typename = void>
+struct has_resource_hash : std::false_type {};
+template<typename T>
+struct has_resource_hash<T, std::void_t<decltype( resource_hash<T>{}( std::declval<T const&>() ) )> > : std::true_type {};
+
+template<typename T, typename = void>
+struct is_trivial_range : std::false_type {};
+template<typename T>
+struct is_trivial_range<T, std::enable_if_t< is_contiguous_container<T>::value > > :
+        std::bool_constant< std::is_trivially_copyable<typename T::value_type>::value > {};
+
+/**
+ * @brief The resource_type struct
+ *
+ * Describes the type of the object stored in a resource_node. There is
+ * exactly one instance per type, so types can be compared by address.
+ *
+ * hash is null if the type is not hashable (see resource_hash), and copy
+ * is null if it is not copy constructible. bytes estimates the memory
+ * used by an object, including the elements of contiguous containers.
+ */
+struct resource_type
+{
+    std::type_info const & type;
+    std::size_t            size;
+    std::size_t            align;
+    void                (* destroy)(void*);
+    std::size_t         (* hash)(void const*);
+    void                (* copy)(void*, void const*); // copy constructs into uninitialized storage
+    std::size_t         (* bytes)(void const*);
+
+    template<typename T>
+    static resource_type const & get()
+    {
+        static const resource_type t{ typeid(T), sizeof(T), alignof(T),
+                                      [](void * p)
+                                      {
+                                          static_cast<T*>(p)->~T();
+                                      },
+                                      make_hash<T>(),
+                                      make_copy<T>(),
+                                      [](void const * p) -> std::size_t
+                                      {
+                                          if constexpr( is_contiguous_container<T>::value )
+                                              return sizeof(T) + static_cast<T const*>(p)->size() * sizeof(typename T::value_type);
+                                          else
+                                              return sizeof(T);
+                                      } };
+        return t;
+    }
+
+protected:
+    template<typename T>
+    static constexpr std::size_t (* make_hash())(void const*)
+    {
+        if constexpr( has_resource_hash<T>::value )
+            return [](void const * p) -> std::size_t { return resource_hash<T>{}( *static_cast<T const*>(p) ); };
+        else if constexpr( has_std_hash<T>::value )
+            return [](void const * p) -> std::size_t { return std::hash<T>{}( *static_cast<T const*>(p) ); };
+        else if constexpr( is_trivial_range<T>::value )
+            return [](void const * p) -> std::size_t
+            {
+                auto & c = *static_cast<T const*>(p);
+                std::string_view bytes( reinterpret_cast<char const*>( c.data() ), c.size() * sizeof(typename T::value_type) );
+                return std::hash<std::string_view>{}(bytes);
+            };
+        else
+            return nullptr;
+    }
+
+    template<typename T>
+    static constexpr void (* make_copy())(void*, void const*)
+    {
+        if constexpr( std::is_copy_constructible<T>::value )
+            return [](void * d, void const * p) { new (d) T( *static_cast<T const*>(p) ); };
+        else
+            return nullptr;
+    }
+};
+
+/**
+ * @brief this_thread_resource_version
+ * @return
+ *
+ * The version of the resources read and written by the calling thread.
+ * Set by the pipelined_executor while it executes a node of a frame,
+ * otherwise 0.
+ */
+inline uint32_t & this_thread_resource_version()
+{
+    thread_local uint32_t v = 0;
+    return v;
+}
+
+/**
+ * @brief The resource_node class
+ * A resource node is a node which holds a resource and is created or consumed by an exec_node.
+ *
+ * An exec_node is executed when all it's required resources have become available.
+ */
+class resource_node
 {
 protected:
     friend class ResourceRegistry;
-    resource_node_w m_node;
+    friend class node_graph;
+    friend class exec_node;
+    friend class node_cache;
+    template<typename> friend class pipelined_executor;
+
+    struct version
+    {
+        void * data = nullptr;                        // storage for the resource
+        bool   constructed = false;                   // true if an object has been constructed in data
+    };
+
+    version                  m_value;                 // version 0, allocated at registration
+    version                * m_versions = nullptr;    // versions 1..m_num_versions-1, see set_num_versions()
+    uint32_t                 m_num_versions = 1;
+    resource_type const    * m_type = nullptr;        // the type of the object stored in the versions
+    std::pmr::memory_resource * m_memory;             // memory resource of the parent graph
+    std::string              m_name;
+    std::pmr::vector<exec_node_w> m_Nodes; // list of nodes that must be triggered
+                                     // when resource becomes availabe
+    std::atomic<bool>        m_is_available{false};
+    resource_flags           m_flags;
+
+    exec_node_w              m_parent;
+    exec_node              * m_producer = nullptr;  // the node which writes the resource, if any
+    node_graph             * m_Graph = nullptr; // the parent graph
+    uint32_t                 m_index = 0;       // index of this resource in the compiled plan
+    uint64_t                 m_revision = 0;    // incremented each time the producer publishes a new value
+
+    bool                     m_transient = false;          // destroyed once its last consumer has finished
+    bool                     m_aliased   = false;          // m_value.data points into the graph's transient pool
+    uint32_t                 m_num_consumers = 0;
+    std::atomic<uint32_t>    m_consumers_left{0};
+    exec_node              * m_next_occupant = nullptr;    // producer of the resource which reuses the storage next
 public:
-    static constexpr bool is_fundamental = std::is_fundamental<T>::value;
-    static constexpr bool is_pointer_type  = (std::is_pointer<T>::value || is_shared_ptr<T>::value);
+    time_point m_time_available;
+
+    explicit resource_node(std::pmr::memory_resource * memory = std::pmr::get_default_resource()) :
+        m_memory(memory),
+        m_Nodes(memory)
+    {
+    }
+
+    ~resource_node()
+    {
+        set_num_versions(1);
+        if( m_value.data )
+        {
+            destroy(m_value);
+            if( !m_aliased )
+                m_memory->deallocate(m_value.data, m_type->size, m_type->align);
+        }
+    }
+
+    /**
+     * @brief set_num_versions
+     * @param n
+     *
+     * Allocates storage for n versions of the resource, so that n frames
+     * can be in flight at once. The version used is selected by
+     * this_thread_resource_version(). Permanent resources only have
+     * a single version.
+     */
+    void set_num_versions(uint32_t n)
+    {
+        if( n == 0 || m_flags == resource_flags::permanent || !m_type )
+            n = 1;
+        if( n == m_num_versions )
+            return;
+        if( n > 1 && m_aliased )
+            unalias(); // the versions of other frames would overlap in the pool
+
+        if( m_versions )
+        {
+            for(uint32_t i=0; i+1 < m_num_versions; ++i)
+            {
+                destroy(m_versions[i]);
+                m_memory->deallocate(m_versions[i].data, m_type->size, m_type->align);
+            }
+            m_memory->deallocate(m_versions, sizeof(version)*(m_num_versions-1), alignof(version));
+            m_versions = nullptr;
+        }
+
+        m_num_versions = n;
+        if( n > 1 )
+        {
+            m_versions = static_cast<version*>( m_memory->allocate(sizeof(version)*(n-1), alignof(version)) );
+            for(uint32_t i=0; i+1 < n; ++i)
+            {
+                new (&m_versions[i]) version{ m_memory->allocate(m_type->size, m_type->align), false };
+            }
+        }
+    }
+
+    uint32_t get_num_versions() const
+    {
+        return m_num_versions;
+    }
+
+    /**
+     * @brief init_storage
+     *
+     * Allocates the storage for a resource of type T. If the storage has
+     * already been allocated, checks that it was allocated for the
+     * same type.
+     */
+    template<typename T>
+    void init_storage()
+    {
+        auto & type = resource_type::get<T>();
+        if( m_type )
+        {
+            if( m_type->type != type.type )
+            {
+                throw std::runtime_error(std::string("Resource ") + std::string(m_name) + std::string(" registered as ")
+                                         + type.type.name() + std::string(" but previously registered as ")
+                                         + m_type->type.name() );
+            }
+            return;
+        }
+        m_type = &type;
+        m_value.data = m_memory->allocate(sizeof(T), alignof(T));
+    }
+
+    /**
+     * @brief destroy
+     *
+     * Destroys the object stored in the resource, if one has been constructed.
+     * The storage itself is kept.
+     */
+    void destroy()
+    {
+        destroy( current() );
+    }
+
+    /**
+     * @brief emplace
+     * @param __args
+     *
+     * Constructs the resource in place, destroying the previous object if there is one.
+     */
+    template<typename T, typename... _Args>
+    T & emplace(_Args&&... __args)
+    {
+        auto & V = current();
+        destroy(V);
+        auto p = new (V.data) T( std::forward<_Args>(__args)... );
+        V.constructed = true;
+        return *p;
+    }
+
+    /**
+     * @brief assign
+     * @param x
+     *
+     * Assigns a new value to the resource, constructing it if it
+     * has not been constructed yet.
+     */
+    template<typename T, typename U>
+    void assign(U && x)
+    {
+        auto & V = current();
+        if( V.constructed )
+            *static_cast<T*>(V.data) = std::forward<U>(x);
+        else
+            emplace<T>( std::forward<U>(x) );
+    }
+
+    /**
+     * @brief assign_copy
+     * @param src - an object of the resource's type
+     *
+     * Replaces the resource with a copy of src. The type must be
+     * copy constructible.
+     */
+    void assign_copy(void const * src)
+    {
+        auto & V = current();
+        destroy(V);
+        m_type->copy(V.data, src);
+        V.constructed = true;
+    }
+
+    /**
+     * @brief make_available
+     * @param av
+     *
+     * Makes the resource available to other nodes. If this resource is needed by another node, that node
+     * will be scheduled for execution so long as all other required resources are satisfied
+     */
+    void make_available(bool av = true)
+    {
+        m_is_available.store(av, std::memory_order_release);
+        m_time_available = clock::now();
+    }
+
+    /**
+     * @brief try_make_available
+     * @return
+     *
+     * Makes the resource available. Returns true only for the call which
+     * changed the resource from unavailable to available.
+     */
+    bool try_make_available()
+    {
+        if( m_is_available.exchange(true, std::memory_order_acq_rel) )
+            return false;
+        m_time_available = clock::now();
+        return true;
+    }
+
+    resource_flags get_flags() const
+    {
+        return m_flags;
+    }
+
+    /**
+     * @brief is_available
+     * @return
+     *
+     * Returns true if this resource is available
+     */
+    bool is_available() const
+    {
+        return m_is_available.load(std::memory_order_acquire);
+    }
+
+    time_point get_time() const
+    {
+        return m_time_available;
+    }
+    std::chrono::microseconds get_time(time_point start) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(m_time_available-start);
+    }
+
+    /**
+     * @brief get_data
+     * @return
+     *
+     * Gets a pointer to the object stored in the resource. Debug builds
+     * assert that it has been constructed.
+     */
+    void * get_data()
+    {
+        assert( current().constructed );
+        return current().data;
+    }
+
+    /**
+     * @brief get_as
+     * @return
+     *
+     * Gets a reference to the resource cast to T, without the checks made
+     * by Get(). Debug builds assert that the resource holds an object of
+     * type T.
+     */
+    template<typename T>
+    T & get_as()
+    {
+        auto & V = current();
+        assert( m_type && m_type->type == typeid(T) && V.constructed );
+        return *static_cast<T*>(V.data);
+    }
+
+    /**
+     * @brief has_value
+     * @return
+     *
+     * Returns true if the resource has been emplaced() or set()
+     */
+    bool has_value() const
+    {
+        return current().constructed;
+    }
+
+    /**
+     * @brief get_type
+     * @return
+     *
+     * Returns the type of the resource.
+     */
+    std::type_info const & get_type() const
+    {
+        return m_type->type;
+    }
+
+    bool has_parent() const
+    {
+        return m_parent.lock()!=nullptr;
+    }
+
+    /**
+     * @brief is_transient
+     * @return
+     *
+     * Returns true if the resource is destroyed once its last consumer has
+     * finished. See node_graph::set_transient_aliasing().
+     */
+    bool is_transient() const
+    {
+        return m_transient;
+    }
+    /**
+     * @brief Get
+     * @return
+     *
+     * Gets a reference to the resource cast to the particular type. Throws an
+     * exception if the resource has not been created or is a different type.
+     */
+    template<typename T>
+    T & Get()
+    {
+        if( !m_type || m_type->type != typeid(T) )
+            throw std::runtime_error(std::string("Resource ") + std::string(m_name) + std::string(" is not of type ") + typeid(T).name());
+        auto & V = current();
+        if( !V.constructed )
+            throw std::runtime_error(std::string("Resource ") + std::string(m_name) + std::string(" has not been created"));
+        return *static_cast<T*>(V.data);
+    }
+
+    std::string const & get_name() const
+    {
+        return m_name;
+    }
+
+    std::string_view name_view() const
+    {
+        return m_name;
+    }
+
+    uint32_t get_index() const
+    {
+        return m_index;
+    }
+
+    /**
+     * @brief get_revision
+     * @return
+     *
+     * Returns the number of times the resource has been published with a
+     * new value. A value which is published again with out_resource::keep()
+     * keeps its revision.
+     */
+    uint64_t get_revision() const
+    {
+        return m_revision;
+    }
+
+    void bump_revision()
+    {
+        ++m_revision;
+    }
+
+    /**
+     * @brief notify_dependents
+     *
+     * Notify all nodes waiting on this resource that this resource is available.
+     */
+    void notify_dependents();
+
+    /**
+     * @brief publish
+     *
+     * Makes the resource available and notifies its dependents, unless it
+     * was already available. When the graph is executed by a
+     * pipelined_executor, the resource is made available for the
+     * frame being executed by the calling thread only.
+     */
+    void publish();
+
+protected:
+    /**
+     * @brief alias
+     * @param p - storage suitable for the resource's type
+     *
+     * Destroys the value and stores it at p from now on, releasing the
+     * resource's own storage.
+     */
+    void alias(void * p)
+    {
+        destroy(m_value);
+        if( !m_aliased )
+            m_memory->deallocate(m_value.data, m_type->size, m_type->align);
+        m_value.data = p;
+        m_aliased    = true;
+    }
+
+    /**
+     * @brief unalias
+     *
+     * Destroys the value and gives the resource its own storage again.
+     */
+    void unalias()
+    {
+        if( !m_aliased )
+            return;
+        destroy(m_value);
+        m_value.data = m_memory->allocate(m_type->size, m_type->align);
+        m_aliased    = false;
+    }
+
+    version & current()
+    {
+        if( m_versions )
+        {
+            auto v = this_thread_resource_version();
+            if( v && v < m_num_versions )
+                return m_versions[v-1];
+        }
+        return m_value;
+    }
+
+    version const & current() const
+    {
+        return const_cast<resource_node*>(this)->current();
+    }
+
+    void destroy(version & V)
+    {
+        if( V.constructed )
+        {
+            m_type->destroy(V.data);
+            V.constructed = false;
+        }
+    }
+};
+
+/**
+ * @brief The compiled_graph struct
+ *
+ * An immutable, index based execution plan produced by node_graph::compile().
+ *
+ * Nodes and resources are stored in contiguous arrays and all edges are stored
+ * as integer indices in CSR form: the edges of element i are found in the range
+ * [offsets[i], offsets[i+1]). Nodes are stored in topological order.
+ *
+ * The plan holds raw pointers into the graph and is only valid until the graph
+ * is modified.
+ */
+struct compiled_graph
+{
+    std::vector<exec_node*>     nodes;
+    std::vector<resource_node*> resources;
+
+    std::vector<uint32_t> node_input_offsets;        // node -> required resources
+    std::vector<uint32_t> node_inputs;
+    std::vector<uint32_t> node_output_offsets;       // node -> produced resources
+    std::vector<uint32_t> node_outputs;
+    std::vector<uint32_t> resource_consumer_offsets; // resource -> nodes which require it
+    std::vector<uint32_t> resource_consumers;
+
+    std::vector<uint32_t> predecessor_count;         // number of required resources for each node
+    std::vector<uint32_t> roots;                     // nodes which do not require any resources
+
+    std::size_t transient_bytes      = 0;            // storage of the aliased resources, if each had its own
+    std::size_t transient_pool_bytes = 0;            // size of the pool they share
+
+    bool empty() const
+    {
+        return nodes.empty();
+    }
+
+    void clear()
+    {
+        *this = compiled_graph();
+    }
+};
+//===============================================================================
+template<typename T> struct is_shared_ptr : std::false_type {};
+template<typename T> struct is_shared_ptr<std::shared_ptr<T>> : std::true_type {};
+//===============================================================================
+/**
+ * @brief The in_resource class
+ *
+ * Class used to register an input resource.
+ */
+template<typename T>
+class in_resource
+{
+    static constexpr bool is_fundamental = std::is_fundamental<T>::value;
+    static constexpr bool is_pointer_type  = (std::is_pointer<T>::value || is_shared_ptr<T>::value);
+
+protected:
+    friend class ResourceRegistry;
+    resource_node * m_node = nullptr; // owned by the node_graph
+public:
+
+    /**
+     * @brief get
+     * @return
+     *
+     * Gets a reference to the resource. The type was checked when the
+     * resource was registered, so only debug builds check it again.
+     */
+    T & get()
+    {
+        return m_node->template get_as<T>();
+    }
+
+
+    //============================================================================
+    // Allows dereferencing if T is a fundamental type:
+    //============================================================================
+    T & operator*()
+    {
+        return get();
+    }
+
+    //============================================================================
+    // Allows allow using -> if T is a pointer
+    //============================================================================
+    template< typename U=T >
+    typename std::enable_if< std::is_same<T,U>::value && is_pointer_type, U&>::type
+    operator->()
+    {
+        return get();
+    }
+
+
+    template<
+    typename U = T,
+    typename = typename std::enable_if< std::is_same<T,U>::value >::type>
+    operator U() {
+        return get();
+    }
+
+};
+
+/**
+ * @brief The out_resource class
+ *
+ * Class for outgoing resources.
+ */
+template<typename T>
+class out_resource
+{
+protected:
+    friend class ResourceRegistry;
+    resource_node * m_node = nullptr; // owned by the node_graph
+public:
+    static constexpr bool is_fundamental = std::is_fundamental<T>::value;
+    static constexpr bool is_pointer_type  = (std::is_pointer<T>::value || is_shared_ptr<T>::value);
+    /**
+     * @brief get
+     * @return
+     *
+     * Returns a reference to the resource. The resource must have
+     * been emplaced() or set() first, which debug builds assert.
+     */
+    T & get()
+    {
+        return m_node->template get_as<T>();
+    }
+
+    /**
+     * @brief has_value
+     * @return
+     *
+     * Returns true if the resource still holds the value of a previous
+     * frame, which can be modified in place with get() instead of being
+     * constructed again, eg: to reuse the capacity of a container.
+     */
+    bool has_value() const
+    {
+        return m_node->has_value();
+    }
+
+    /**
+     * @brief make_available
+     * Makes this resource available. Once it is available, any ExecNodes
+     * which require this resource will be allowed to execute.
+     */
+    void make_available()
+    {
+        auto node = m_node;
+        if( node )
+        {
+            node->bump_revision();
+            node->publish();
+        }
+    }
+
+    /**
+     * @brief keep
+     *
+     * Makes the resource available with the value it held in the previous
+     * frame, marking it as unchanged. When the graph is incremental,
+     * nodes whose inputs are all unchanged are skipped.
+     */
+    void keep()
+    {
+        if( !m_node->has_value() )
+            throw std::runtime_error(std::string("Resource ") + std::string(m_node->get_name()) + std::string(" cannot be kept, it has not been created"));
+        m_node->publish();
+    }
+
+    /**
+     * @brief set_if_changed
+     * @param x
+     *
+     * Same as set(x), unless the resource already holds a value equal
+     * to x, in which case it is kept. T must be equality comparable.
+     */
+    void set_if_changed(T const & x)
+    {
+        if( m_node->has_value() && get() == x )
+            keep();
+        else
+            set(x);
+    }
+
+    /**
+     * @brief emplace
+     * @param __args
+     *
+     * Construct the resource in place
+     */
+    template<typename... _Args>
+    void emplace(_Args&&... __args)
+    {
+      m_node->template emplace<T>( std::forward<_Args>(__args)...);
+    }
+
+    /**
+     * @brief set
+     * @param x
+     * @param make_avail
+     *
+     * Sets the resource
+     */
+    void set(T const & x, bool make_avail=true)
+    {
+        m_node->template assign<T>(x);
+        if( make_avail) make_available();
+    }
+
+    void set(T && x, bool make_avail=true)
+    {
+        m_node->template assign<T>( std::move(x) );
+        if( make_avail) make_available();
+    }
+
+
+
+
+    //============================================================================
+    // Allows allow using -> if T is a pointer
+    //============================================================================
+    template< typename U=T >
+    typename std::enable_if< std::is_same<T,U>::value && is_pointer_type, U&>::type
+    operator->()
+    {
+        return get();
+    }
+
+
+    template<
+    typename U = T,
+    typename = typename std::enable_if< std::is_same<T,U>::value >::type>
+    operator U() {
+        return get();
+    }
+
+    //============================================================================
+    // Allows dereferencing if T is a fundamental type:
+    //============================================================================
+    T & operator*()
+    {
+        return get();
+    }
+};
+
+
+
+
+/**
+ * @brief hash_name
+ * @param name
+ * @return
+ *
+ * 64-bit FNV-1a hash of a resource name. Can be evaluated at compile time.
+ */
+constexpr uint64_t hash_name(std::string_view name)
+{
+    uint64_t h = 14695981039346656037ull;
+    for(auto c : name)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * @brief The resource_name struct
+ *
+ * A resource name together with its hash. When constructed from a string
+ * literal in a constant expression (or with the _rn literal) the hash is
+ * computed at compile time.
+ *
+ *   constexpr graphe::resource_name b("b");
+ *   R.register_input_resource<int>(b);
+ */
+struct resource_name
+{
+    std::string_view name;
+    uint64_t         hash;
+
+    constexpr resource_name(const char * n) : name(n), hash(hash_name(name))
+    {
+    }
+    constexpr resource_name(std::string_view n) : name(n), hash(hash_name(name))
+    {
+    }
+    resource_name(std::string const & n) : name(n), hash(hash_name(name))
+    {
+    }
+};
+
+namespace literals
+{
+constexpr resource_name operator""_rn(const char * s, std::size_t n)
+{
+    return resource_name( std::string_view(s,n) );
+}
+}
+
+/**
+ * @brief The resource_name_table class
+ *
+ * Interns resource names into compact integer ids using an open-addressing
+ * hash table with linear probing. Ids are assigned in order of insertion,
+ * starting at 0.
+ */
+class resource_name_table
+{
+public:
+    static constexpr uint32_t npos = 0xFFFFFFFF;
+
+    explicit resource_name_table(std::pmr::memory_resource * memory = std::pmr::get_default_resource()) :
+        m_slots(16, slot{0,npos}, memory),
+        m_names(memory)
+    {
+    }
+
+    /**
+     * @brief find
+     * @param n
+     * @return
+     *
+     * Returns the id of the name, or npos if the name has not been interned.
+     */
+    uint32_t find(resource_name n) const
+    {
+        auto mask = m_slots.size()-1;
+        for(auto i = n.hash & mask; m_slots[i].id != npos; i = (i+1) & mask)
+        {
+            if( m_slots[i].hash == n.hash && m_names[m_slots[i].id] == n.name )
+                return m_slots[i].id;
+        }
+        return npos;
+    }
+
+    /**
+     * @brief insert
+     * @param n
+     * @return
+     *
+     * Interns the name. Returns the id of the name and true if the
+     * name was not previously in the table.
+     */
+    std::pair<uint32_t,bool> insert(resource_name n)
+    {
+        auto mask = m_slots.size()-1;
+        auto i    = n.hash & mask;
+        for(; m_slots[i].id != npos; i = (i+1) & mask)
+        {
+            if( m_slots[i].hash == n.hash && m_names[m_slots[i].id] == n.name )
+                return {m_slots[i].id, false};
+        }
+
+        auto id = static_cast<uint32_t>(m_names.size());
+        m_names.emplace_back(n.name);
+        m_slots[i] = slot{n.hash, id};
+
+        if( 2*m_names.size() > m_slots.size() ) // keep the load factor below 0.5
+            grow();
+
+        return {id, true};
+    }
+
+    std::string_view name(uint32_t id) const
+    {
+        return m_names[id];
+    }
+
+    std::size_t size() const
+    {
+        return m_names.size();
+    }
+
+protected:
+    struct slot
+    {
+        uint64_t hash;
+        uint32_t id;
+    };
+
+    void grow()
+    {
+        std::pmr::vector<slot> slots(m_slots.size()*2, slot{0,npos}, m_slots.get_allocator());
+        auto mask = slots.size()-1;
+        for(auto & s : m_slots)
+        {
+            if( s.id == npos ) continue;
+            auto i = s.hash & mask;
+            while( slots[i].id != npos ) i = (i+1) & mask;
+            slots[i] = s;
+        }
+        m_slots.swap(slots);
+    }
+
+    std::pmr::vector<slot>             m_slots;
+    std::pmr::vector<std::pmr::string> m_names; // indexed by id
+};
+
+class ResourceRegistry
+{
+    exec_node_p & m_Node;
+    resource_name_table & m_names;
+    std::pmr::vector<resource_node_p> & m_resources; // indexed by the id of the resource's name
+    std::pmr::vector<resource_node_w> & m_required_resources;
+
+    /**
+     * @brief get_resource
+     * @return
+     *
+     * Returns the resource with the given name, creating it if it does not
+     * exist. The second value is true if the resource was created.
+     */
+    std::pair<resource_node_p,bool> get_resource(resource_name name)
+    {
+        auto id = m_names.insert(name);
+        if( !id.second )
+            return { m_resources[id.first], false };
+
+        auto RN = std::allocate_shared<resource_node>( std::pmr::polymorphic_allocator<resource_node>(m_Node->m_memory), m_Node->m_memory );
+        RN->m_name  = name.name;
+        RN->m_Graph = m_Node->m_Graph;
+        RN->m_index = id.first;
+        m_resources.push_back(RN);
+        return {RN, true};
+    }
+
+    public:
+        ResourceRegistry( exec_node_p & node,
+                          resource_name_table & names,
+                          std::pmr::vector<resource_node_p> & resources,
+                          std::pmr::vector<resource_node_w> & required_resources) :
+            m_Node(node),
+            m_names(names),
+            m_resources(resources),
+            m_required_resources(required_resources)
+        {
+
+        }
+
+        template<typename T, resource_flags F=resource_flags::resetable>
+        out_resource<T> register_output_resource(resource_name name)
+        {
+            auto [RN, created] = get_resource(name);
+            if( created )
+            {
+                RN->m_flags    = F;
+                RN->m_parent   = m_Node;
+            }
+            else if(RN->m_flags != F)
+            {
+                throw std::runtime_error(std::string("Resource ") + std::string(name.name) + std::string(" previously registered as different type") );
+            }
+            RN->template init_storage<T>();
+
+            m_Node->m_producedResources.push_back(RN);
+            RN->m_producer = m_Node.get();
+
+            out_resource<T> r;
+            r.m_node = RN.get();
+            return r;
+        }
+
+        template<typename T, resource_flags F=resource_flags::resetable>
+        in_resource<T> register_input_resource(resource_name name)
+        {
+            auto [RN, created] = get_resource(name);
+            if( created )
+            {
+                RN->m_flags = F;
+            }
+            else if(RN->m_flags != F)
+            {
+                throw std::runtime_error(std::string("Resource ") + std::string(name.name) + std::string(" previously registered as different type") );
+            }
+            RN->template init_storage<T>();
+            RN->m_Nodes.push_back(m_Node);
+
+            m_required_resources.push_back(RN);
+            if( !(F == resource_flags::permanent && RN->is_available()) )
+                ++m_Node->m_initial_pending;
+
+            in_resource<T> r;
+            r.m_node = RN.get();
+            return r;
+        }
+};
+
+
+class node_graph
+{
+public:
+    node_graph() : m_memory( std::pmr::get_default_resource() )
+    {
+    }
+
+    /**
+     * @brief node_graph
+     * @param arena_size - the initial size of the arena in bytes.
+     *
+     * Creates a graph which places all of its nodes, resources, edge lists
+     * and its table of resource names in a single monotonic arena owned by
+     * the graph. get_name() returns a std::string, so the copies of the
+     * names held by nodes and resources are allocated from the heap. Memory is
+     * never returned to the arena while the graph is alive; it is all freed
+     * in one shot when the graph is destroyed.
+     *
+     * Any exec_node_p or resource_node_p obtained from the graph must not
+     * outlive the graph.
+     */
+    explicit node_graph(std::size_t arena_size) :
+        m_arena( new std::pmr::monotonic_buffer_resource(arena_size) ),
+        m_memory( m_arena.get() )
+    {
+    }
+    ~node_graph()
+    {
+        release_transients();
+
+        std::sort( m_exec_nodes.begin(), m_exec_nodes.end(),
+                   [](exec_node_p & l, exec_node_p & r)
+        {
+            return l->m_exec_start_time_us < r->m_exec_start_time_us;
+        });
+
+        for([[maybe_unused]] auto & e : m_exec_nodes)
+        {
+            //std::cout << e->get_name() << " use count: " << e.use_count() << "  time: " << e->m_exec_start_time_us.count() << std::endl;
+        }
+
+        while(m_exec_nodes.size())
+        {
+            m_exec_nodes.pop_back();
+        }
+    }
+
+    node_graph( node_graph const & other) = delete;
+    node_graph( node_graph && other) = delete;
+    node_graph & operator = ( node_graph const & other) = delete;
+    node_graph & operator = ( node_graph && other) = delete;
+
+
+    template<typename _Tp, typename... _Args>
+    /**
+     * @brief add_oneshot_node
+     * @param __args
+     * @return
+     *
+     * Add a one-shot node to the graph. A one-shot node only executes once.
+     *
+     * A one-shot nodemay only register "permanent" resources.
+     */
+    inline exec_node & add_oneshot_node(_Args&&... __args)
+    {
+        return add_node_flags<node_flags::execute_once,_Tp>( std::forward<_Args>(__args)... );
+    }
+
+    /**
+     * @brief add_node
+     * @param __args
+     * @return
+     *
+     * Add a regular exec node to the graph
+     */
+    template<typename _Tp, typename... _Args>
+    inline exec_node & add_node(_Args&&... __args)
+    {
+        return add_node_flags<node_flags::execute_multiple,_Tp>( std::forward<_Args>(__args)... );
+    }
+    /**
+     * @brief AddNode
+     * @param __args
+     *
+     * Add a node to the Graph. The template class _Tp must contain a struct
+     * named Data_t.
+     */
+    template<node_flags F, typename _Tp, typename... _Args>
+    inline exec_node & add_node_flags(_Args&&... __args)
+    {
+      typedef typename std::remove_const<_Tp>::type Node_t;
+      return add_exec_node< exec_node_t<Node_t>, F, _Tp >( std::forward<_Args>(__args)... );
+    }
+
+    /**
+     * @brief add_parallel_node
+     * @param __args
+     * @return
+     *
+     * Adds a node whose work is split into chunks which are executed in
+     * parallel. The Node class must provide size(), chunk_size() and
+     * operator()(std::size_t begin, std::size_t end) instead of operator()().
+     * Its output resources become available once every chunk has finished.
+     *
+     * The chunks are handed to the thread pool through the graph's onSpawn
+     * callback, which threaded_executor sets. Without it (eg: with the
+     * serial_executor) all the chunks are executed by the thread running
+     * the node.
+     */
+    template<typename _Tp, typename... _Args>
+    inline exec_node & add_parallel_node(_Args&&... __args)
+    {
+      typedef typename std::remove_const<_Tp>::type Node_t;
+      auto & N = add_exec_node< parallel_exec_node_t<Node_t>, node_flags::execute_multiple, _Tp >( std::forward<_Args>(__args)... );
+
+      auto rawp = static_cast<parallel_exec_node*>(&N);
+      rawp->help = [rawp]()
+      {
+          rawp->run_chunks();
+          rawp->m_Graph->m_numSpawned.fetch_sub(1, std::memory_order_release);
+      };
+      return N;
+    }
+
+    /**
+     * @brief add_async_node
+     * @param __args
+     * @return
+     *
+     * Adds a node whose () operator is a coroutine returning
+     * graphe::node_task. The node may co_await timers and completions,
+     * releasing its thread while it is suspended, and its outputs become
+     * available when the coroutine returns. Requires C++20 and
+     * graph-e/coro_node.h.
+     *
+     * The node is resumed through the graph's onSpawn callback, which
+     * every executor installs: threaded_executor and multi_graph_executor
+     * continue it on their pool, serial_executor (and threaded_executor
+     * in inline frames) on the thread in execute(), which waits for it.
+     */
+    template<typename _Tp, typename... _Args>
+    inline exec_node & add_async_node(_Args&&... __args)
+    {
+      typedef typename std::remove_const<_Tp>::type Node_t;
+      return add_exec_node< async_exec_node_t<Node_t>, node_flags::execute_multiple, _Tp >( std::forward<_Args>(__args)... );
+    }
+
+protected:
+    template<typename Exec_t, node_flags F, typename _Tp, typename... _Args>
+    inline exec_node & add_exec_node(_Args&&... __args)
+    {
+      auto T  = std::allocate_shared< Exec_t >( std::pmr::polymorphic_allocator< Exec_t >(m_memory), m_memory );
+      exec_node_p N = T;
+
+      N->m_flags = F;
+      N->m_Graph = this;
+      ResourceRegistry R(N,  m_names, m_resources,  N->m_requiredResources);
+
+      T->construct( R, std::forward<_Args>(__args)...);
+
+      N->m_name      = typeid( _Tp).name();// "Node_" + std::to_string(global_count++);
+      exec_node* rawp = N.get();
+
+      // The functor handed to thread pools.
+      N->execute = [rawp]()
+      {
+          rawp->run();
+      };
+
+      if( F == node_flags::execute_once)
+      {
+          for( auto & r : N->m_producedResources)
+          {
+              auto R = r.lock();
+              if( R->get_flags() != resource_flags::permanent )
+              {
+
+                throw std::runtime_error( std::string("Node, set as ExecuteOnce, but produces resettable resource, ") + std::string(R->get_name()) + std::string(". Nodes set as ExecuteOnce may only produce permenant resources.") );
+              }
+          }
+      }
+
+      //std::any_cast< Node_t&>(N->m_NodeClass).registerResources( std::any_cast< Data_t&>( rawp->m_NodeData ), R);
+
+      N->m_pending = N->m_initial_pending.load();
+
+      // record_inputs() runs on the pool's workers, and the arena is not
+      // thread safe, so the storage is allocated here, once
+      N->m_input_revisions.reserve( N->m_requiredResources.size() );
+
+      m_exec_nodes.push_back(N);
+      release_transients();
+      m_plan.clear(); // the graph has changed, it needs to be recompiled
+
+      return *N;
+    }
+
+public:
+
+    /**
+     * @brief compile
+     *
+     * Freezes the current structure of the graph into a compiled_graph. Once
+     * compiled, scheduling walks the flat index arrays of the plan instead
+     * of the weak pointers stored in each node.
+     *
+     * Adding a new node clears the plan. If reset() removes any one-shot
+     * nodes, the graph is recompiled automatically.
+     */
+    void compile()
+    {
+        compiled_graph P;
+
+        // Assign every resource an index
+        // Resources are indexed by the id of their name
+        P.resources.reserve( m_resources.size() );
+        for(auto & r : m_resources)
+        {
+            P.resources.push_back( r.get() );
+        }
+
+        // Resources which no node produces (eg: external resources, or
+        // permanent resources whose one-shot producer has been removed)
+        // are never waited on by the sort.
+        std::vector<bool> produced( m_resources.size(), false );
+        for(auto & n : m_exec_nodes)
+        {
+            for(auto & r : n->m_producedResources)
+                produced[ r.lock()->m_index ] = true;
+        }
+
+        // Count the number of produced resources each node requires and
+        // sort the nodes topologically (Kahn's algorithm) so that
+        // producers are stored before their consumers.
+        std::map<exec_node*, uint32_t> remaining;
+        std::vector<exec_node*> ready;
+        for(auto & n : m_exec_nodes)
+        {
+            uint32_t count = 0;
+            for(auto & r : n->m_requiredResources)
+                count += produced[ r.lock()->m_index ] ? 1 : 0;
+            remaining[n.get()] = count;
+            if( count == 0 )
+                ready.push_back(n.get());
+        }
+
+        P.nodes.reserve( m_exec_nodes.size() );
+        for(size_t i=0; i < ready.size(); ++i)
+        {
+            exec_node * n = ready[i];
+            P.nodes.push_back(n);
+            for(auto & r : n->m_producedResources)
+            {
+                for(auto & c : r.lock()->m_Nodes)
+                {
+                    auto C = c.lock();
+                    if( C && remaining.count(C.get()) && --remaining[C.get()] == 0 )
+                    {
+                        ready.push_back( C.get() );
+                    }
+                }
+            }
+        }
+
+        // Nodes which never become ready (ie: they are part of a cycle)
+        // are placed at the end.
+        for(auto & n : m_exec_nodes)
+        {
+            if( remaining[n.get()] != 0 )
+                P.nodes.push_back(n.get());
+        }
+
+        for(uint32_t i=0; i < P.nodes.size(); ++i)
+        {
+            P.nodes[i]->m_index = i;
+        }
+
+        // Build the adjacency lists
+        P.node_input_offsets.push_back(0);
+        P.node_output_offsets.push_back(0);
+        for(auto n : P.nodes)
+        {
+            for(auto & r : n->m_requiredResources)
+                P.node_inputs.push_back( r.lock()->m_index );
+            for(auto & r : n->m_producedResources)
+                P.node_outputs.push_back( r.lock()->m_index );
+
+            P.node_input_offsets.push_back(  static_cast<uint32_t>(P.node_inputs.size()) );
+            P.node_output_offsets.push_back( static_cast<uint32_t>(P.node_outputs.size()) );
+
+            P.predecessor_count.push_back( static_cast<uint32_t>(n->m_requiredResources.size()) );
+            if( n->m_requiredResources.empty() )
+                P.roots.push_back( n->m_index );
+        }
+
+        P.resource_consumer_offsets.push_back(0);
+        for(auto r : P.resources)
+        {
+            for(auto & c : r->m_Nodes)
+            {
+                if( auto C = c.lock() )
+                    P.resource_consumers.push_back( C->m_index );
+            }
+            P.resource_consumer_offsets.push_back( static_cast<uint32_t>(P.resource_consumers.size()) );
+        }
+
+        m_plan = std::move(P);
+
+        compute_priorities();
+        assign_transients();
+    }
+
+    /**
+     * @brief update_priorities
+     *
+     * Updates each node's estimated cost from the duration measured the last
+     * time it executed, then recomputes the priorities of the compiled
+     * graph. Call this after wait() (or after the serial executor returns)
+     * to schedule from profiled timings.
+     */
+    void update_priorities()
+    {
+        for(auto & n : m_exec_nodes)
+        {
+            if( !n->m_executed ) continue;
+            auto d = static_cast<uint64_t>( std::max<int64_t>(1, n->get_duration().count()) );
+            n->m_cost_ns = n->m_cost_ns ? (n->m_cost_ns + d) / 2 : d; // smooth out the noise
+        }
+        compute_priorities();
+    }
+
+    /**
+     * @brief compute_priorities
+     *
+     * Computes the priority of each node as the longest remaining path
+     * (sum of the estimated costs) from the node to the end of the graph,
+     * walking the compiled plan in reverse topological order. Nodes with
+     * an unknown cost count as 1ns.
+     */
+    void compute_priorities()
+    {
+        auto & P = m_plan;
+        for(auto i = P.nodes.size(); i-- > 0; )
+        {
+            uint64_t longest = 0;
+            for(auto o = P.node_output_offsets[i]; o < P.node_output_offsets[i+1]; ++o)
+            {
+                auto r = P.node_outputs[o];
+                for(auto c = P.resource_consumer_offsets[r]; c < P.resource_consumer_offsets[r+1]; ++c)
+                {
+                    auto consumer = P.resource_consumers[c];
+                    if( consumer > i ) // ignore back edges of cycles
+                        longest = std::max(longest, P.nodes[consumer]->m_priority);
+                }
+            }
+            P.nodes[i]->m_priority = std::max<uint64_t>(1, P.nodes[i]->m_cost_ns) + longest;
+        }
+    }
+
+    /**
+     * @brief is_compiled
+     * @return
+     *
+     * Returns true if the graph has been compiled and has not been modified since.
+     */
+    bool is_compiled() const
+    {
+        return !m_plan.empty();
+    }
+
+    /**
+     * @brief get_plan
+     * @return
+     *
+     * Returns the compiled plan. The plan is empty if compile() has not been called.
+     */
+    compiled_graph const & get_plan() const
+    {
+        return m_plan;
+    }
+
+    /**
+     * @brief schedule_node
+     * @param p
+     *
+     * Schedules this node for execution.
+     */
+    void schedule_node( exec_node * p)
+    {
+        m_numToExecute.fetch_add(1, std::memory_order_relaxed);
+        if( m_inline_continuation )
+        {
+            auto & C = this_thread_continuation();
+            if( C.graph == this && C.next == nullptr )
+            {
+                // we are inside a node of this graph: run p on this
+                // thread once that node returns
+                C.next = p;
+                return;
+            }
+        }
+        if(onSchedule)
+            onSchedule(p);
+    }
+
+    /**
+     * @brief set_inline_continuation
+     * @param enable
+     *
+     * When enabled, the first dependent which becomes ready while a node
+     * is executing is run on the same thread right after that node
+     * returns, rather than being handed to onSchedule. The remaining
+     * dependents are scheduled as usual. This avoids a queue round trip
+     * (and possibly a move to another core) at each link of a chain.
+     * Must not be changed while the graph is executing.
+     */
+    void set_inline_continuation(bool enable)
+    {
+        m_inline_continuation = enable;
+    }
+
+    bool get_inline_continuation() const
+    {
+        return m_inline_continuation;
+    }
+
+    /**
+     * @brief trigger_all
+     *
+     * Starts a frame: schedules every node whose inputs are available.
+     * The frame holds one extra count on the number of nodes left to
+     * execute while the nodes are being triggered, so that it cannot be
+     * seen as finished before all the initial nodes have been scheduled.
+     */
+    void trigger_all()
+    {
+        m_idle.store(idle_state::running, std::memory_order_relaxed);
+        m_numSkipped.store(0, std::memory_order_relaxed);
+        m_numToExecute.fetch_add(1, std::memory_order_relaxed);
+
+        if( is_compiled() )
+        {
+            for(auto N : m_plan.nodes)
+            {
+                N->trigger(); // a node may already have been scheduled by a producer running on another thread
+            }
+        }
+        else
+        {
+            for(auto & N : m_exec_nodes)
+            {
+                N->trigger();
+            }
+        }
+
+        node_done();
+    }
+
+    /**
+     * @brief wait
+     *
+     * Blocks until the current frame has finished, ie: the last node has
+     * executed and onFinished has returned. Uses std::atomic::wait when
+     * it is available, otherwise a condition variable.
+     */
+    void wait()
+    {
+#if defined(__cpp_lib_atomic_wait)
+        for(uint32_t s; (s = m_idle.load(std::memory_order_acquire)) != idle_state::idle; )
+        {
+            if( s == idle_state::running )
+                m_idle.wait(idle_state::running, std::memory_order_acquire);
+            else
+                std::this_thread::yield(); // the finishing thread is still notifying
+        }
+#else
+        std::unique_lock<std::mutex> lk(m_idle_lock);
+        m_idle_cv.wait(lk, [this] { return m_idle.load(std::memory_order_acquire) == idle_state::idle; } );
+#endif
+    }
+
+    /**
+     * @brief is_idle
+     * @return
+     *
+     * Returns true if the frame started by trigger_all() has finished.
+     */
+    bool is_idle() const
+    {
+        return m_idle.load(std::memory_order_acquire) == idle_state::idle;
+    }
+
+    /**
+     * @brief Reset
+     * @param destroy_resources - destroys all the resources as well. Default is false.
+     */
+    void reset(bool destroy_resources = false)
+    {
+        //std::cout << "size: " << m_exec_nodes.size() << std::endl;
+        auto num_nodes = m_exec_nodes.size();
+        m_exec_nodes.erase(std::remove_if(m_exec_nodes.begin(),
+                                  m_exec_nodes.end(),
+                                  [](exec_node_p & x)
+                                  {
+
+                                      if(x->get_flags() == node_flags::execute_once && x->m_executed)
+                                      {
+                                          for(auto & r : x->m_producedResources)
+                                          {
+                                              auto R = r.lock();
+                                              if( R && R->m_producer == x.get() )
+                                                  R->m_producer = nullptr;
+                                          }
+                                          x.reset();
+                                          return true;
+                                      }
+                                      x->m_executed  = false;
+                                      x->m_scheduled = false;
+                                      x->m_pending   = x->m_initial_pending.load() + x->m_alias_waits;
+                                      return false;
+                                  }),
+                   m_exec_nodes.end());
+//        std::cout << "size: " << m_exec_nodes.size() << std::endl;
+
+        if( is_compiled() && num_nodes != m_exec_nodes.size() )
+        {
+            compile();
+        }
+
+        for(auto & N : m_resources)
+        {
+            if( N->get_flags() != resource_flags::permanent)
+            {
+                N->make_available(false);
+                if( destroy_resources )
+                    N->destroy();
+                if( N->m_transient )
+                    N->m_consumers_left.store(N->m_num_consumers, std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    resource_node_p  get_resources(resource_name name)
+    {
+        auto id = m_names.find(name);
+        if( id == resource_name_table::npos )
+            throw std::out_of_range( std::string("Resource ") + std::string(name.name) + std::string(" does not exist") );
+        return m_resources[id];
+    }
+
+    /**
+     * @brief get_resource_id
+     * @param name
+     * @return
+     *
+     * Returns the interned id of the resource, or resource_name_table::npos
+     * if no resource with that name exists. The id is the index of the
+     * resource in the compiled plan.
+     */
+    uint32_t get_resource_id(resource_name name) const
+    {
+        return m_names.find(name);
+    }
+
+    /**
+     * @brief get_memory_resource
+     * @return
+     *
+     * Returns the memory resource used to allocate the graph's nodes and resources.
+     */
+    std::pmr::memory_resource * get_memory_resource() const
+    {
+        return m_memory;
+    }
+
+    /**
+     * @brief set_profiling
+     * @param enable
+     *
+     * Enables recording of per-node execution statistics. When disabled,
+     * the cost is a single branch per node.
+     */
+    void set_profiling(bool enable)
+    {
+        if( enable )
+        {
+            for(auto & n : m_exec_nodes)
+                n->m_stats.reserve();
+        }
+        m_profiling = enable;
+    }
+
+    bool is_profiling() const
+    {
+        return m_profiling;
+    }
+
+    /**
+     * @brief set_transient_aliasing
+     * @param enable
+     *
+     * When enabled, compile() computes the lifetime of each resetable
+     * resource, from its producer to its last consumer. Each frame, the
+     * resource is destroyed once its last consumer has finished, freeing
+     * any memory it owns. Resources whose lifetimes cannot overlap, ie:
+     * every consumer of one is an ancestor of the producer of the other,
+     * share storage in a pool owned by the graph. A node whose outputs
+     * reuse the storage of another resource does not start until that
+     * resource has been destroyed.
+     *
+     * Resources without consumers are not transient, so they can still be
+     * read once the frame has finished. Takes effect at the next compile().
+     */
+    void set_transient_aliasing(bool enable)
+    {
+        m_transient_aliasing = enable;
+    }
+
+    bool is_transient_aliasing() const
+    {
+        return m_transient_aliasing;
+    }
+
+    /**
+     * @brief set_incremental
+     * @param enable
+     *
+     * When enabled, a node is skipped if none of its inputs has changed
+     * since the last time it ran: its previous outputs are made available
+     * again, unchanged. Resources are changed by out_resource::set(),
+     * emplace() and make_available(), and kept by out_resource::keep()
+     * and set_if_changed(). Nodes without inputs always run. reset() must
+     * not destroy the resources. Not used by the pipelined_executor.
+     * Must not be changed while the graph is executing.
+     */
+    void set_incremental(bool enable)
+    {
+        m_incremental = enable;
+    }
+
+    bool is_incremental() const
+    {
+        return m_incremental;
+    }
+
+    /**
+     * @brief get_num_skipped
+     * @return
+     *
+     * Returns the number of nodes skipped in the current (or last) frame
+     * because their inputs had not changed.
+     */
+    uint32_t get_num_skipped() const
+    {
+        return m_numSkipped.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief clear_stats
+     *
+     * Clears the execution statistics of every node.
+     */
+    void clear_stats()
+    {
+        for(auto & n : m_exec_nodes)
+            n->m_stats.clear();
+    }
+
+    /**
+     * @brief get_stats
+     * @param name
+     * @return
+     *
+     * Returns the statistics of the first node with the given name, or
+     * nullptr if there is no such node.
+     */
+    node_stats const * get_stats(std::string_view name) const
+    {
+        for(auto & n : m_exec_nodes)
+        {
+            if( n->get_name() == name )
+                return &n->m_stats;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief print_stats
+     * @param out
+     *
+     * Prints the execution statistics of every node, in microseconds.
+     */
+    void print_stats(std::ostream & out = std::cout) const
+    {
+        auto us = [](std::chrono::nanoseconds d)
+        {
+            return static_cast<double>(d.count()) / 1000.0;
+        };
+
+        out << std::left << std::setw(24) << "node" << std::right
+            << std::setw(10) << "count"
+            << std::setw(12) << "mean"
+            << std::setw(12) << "min"
+            << std::setw(12) << "max"
+            << std::setw(12) << "p50"
+            << std::setw(12) << "p99" << "\n";
+
+        out << std::fixed << std::setprecision(1);
+        for(auto & n : m_exec_nodes)
+        {
+            auto & S = n->m_stats;
+            out << std::left << std::setw(24) << n->get_name() << std::right
+                << std::setw(10) << S.count()
+                << std::setw(12) << us(S.mean())
+                << std::setw(12) << us(S.min())
+                << std::setw(12) << us(S.max())
+                << std::setw(12) << us(S.p50())
+                << std::setw(12) << us(S.p99()) << "\n";
+        }
+        out << std::defaultfloat;
+    }
+
+    void print_info()
+    {
+        std::cout << "Num Nodes: " << m_exec_nodes.size() << std::endl;
+        std::cout << "Num Resources: " << m_resources.size() << std::endl;
+        std::cout << "Num Running: " << m_numRunning << std::endl;
+        std::cout << "Num To Executing: " << m_numToExecute << std::endl;
+    }
+
+
+    void print_node_resource_order(exec_node_p & e)
+    {
+        for(auto & r : e->m_requiredResources)
+        {
+            std::cout << r.lock()->get_name() << " -> " << e->get_name() << std::endl;
+        }
+        for(auto & r : e->m_producedResources)
+        {
+            std::cout << e->get_name() << " -> " << r.lock()->get_name() << std::endl;
+        }
+        if( e->m_producedResources.size()==0) return;
+
+        //std::cout << e->m_name <<( e->m_producedResources.size()==0?"\n":" -> ");
+
+    }
+
+    void print_node(resource_node_p & N, time_point start)
+    {
+        std::cout << "{\n";
+        std::cout << "    rank=same \n";
+        std::cout << "    " << N->get_name() << "[shape=circle style=filled  color=\"0.650 0.700 0.700\"]\n";
+        if(N->get_time(start).count() != 0) std::cout << "    " << N->get_time(start).count() << "\n";
+        std::cout << "}" << std::endl;;
+    }
+
+    void print_node(exec_node_p & N, time_point start)
+    {
+        std::cout << "{\n";
+        std::cout << "    rank=same \n";
+        std::cout << "    " << N->get_name() << "[shape=square]\n";
+        if(N->get_time(start).count() != 0) std::cout << "    " << N->get_time(start).count() << "\n";
+        std::cout << "}" << std::endl;;
+    }
+
+    /**
+     * @brief print
+     *
+     * Prints the graph in dot format.
+     */
+    void print()
+    {
+
+        std::map<std::thread::id, int> threadProps;
+        std::map<time_point, int> nodes;
+
+        auto min = m_exec_nodes[0]->get_time();
+        for(auto & E : m_exec_nodes)
+        {
+            auto t = E->get_time();
+            min = std::min(min, t);
+            nodes[t]=0;
+        }
+        for(auto & E : m_resources)
+        {
+
+            auto t = E->get_time();
+            if(E->get_flags() != resource_flags::permanent)
+            {
+                min    = std::min(min, t);
+            }
+            nodes[t]=0;
+
+
+        }
+
+        std::cout << "digraph G {" << std::endl;
+
+        auto s = nodes.size();
+        for(auto & E : nodes)
+        {
+            auto t = std::chrono::duration_cast<std::chrono::microseconds>(E.first - min).count();
+            std::cout << t << (s==1? "\n":" -> ") ;
+            s--;
+        };
+
+
+        for(auto & E : m_exec_nodes)
+        {
+            print_node(E,min);
+        }
+        for(auto & E : m_resources)
+        {
+            print_node(E,min);
+        }
+
+        for(auto & E : m_exec_nodes)
+        {
+            print_node_resource_order(E);
+        }
+
+
+        std::cout << "}" << std::endl;
+    }
+
+    std::pmr::vector< exec_node_p > & get_exec_nodes()
+    {
+        return m_exec_nodes;
+    }
+
+
+    uint32_t get_num_running() const
+    {
+        return m_numRunning.load(std::memory_order_relaxed);
+    }
+
+    uint32_t get_left_to_execute() const
+    {
+        return m_numToExecute.load(std::memory_order_relaxed);
+    }
+
     /**
-     * @brief get
+     * @brief busy
      * @return
      *
-     * Returns a reference to the node. This will throw an exception
-     * if the resource has not either been emplaced() or set()
+     * Returns true if the graph is busy. Ie; There are nodes running
      */
-    T & get()
+    bool busy() const
+    {
+        return m_numRunning.load(std::memory_order_acquire)!=0 || m_numToExecute.load(std::memory_order_acquire)!=0;
+    }
+
+    void setOnSchedule( std::function<void(exec_node*)> f)
+    {
+        onSchedule = f;
+    }
+    void clearOnSchedule()
+    {
+        onSchedule = std::function<void(exec_node*)>();
+    }
+
+    void setOnComplete( std::function<void(void)> f)
+    {
+        onFinished = f;
+    }
+    void clearOnComplete()
     {
-        return m_node.lock()->Get<T>();//std::any_cast<T&>( m_node.lock()->m_resource );
+        onFinished = std::function<void(void)> ();
     }
 
     /**
-     * @brief make_available
-     * Makes this resource available. Once it is available, any ExecNodes
-     * which require this resource will be allowed to execute.
+     * @brief setOnExecuted
+     * @param f
+     *
+     * Called on the executing thread after a node has finished, before its
+     * outputs are checked. Used for tracing.
      */
-    void make_available()
+    void setOnExecuted( std::function<void(exec_node*)> f)
     {
-        auto node = m_node.lock();
-        if( node )
-        {
-            if( !node->is_available() )
-            {
-                //std::cout << node->get_name() << " is available" << std::endl;
-                node->make_available();
-                node->notify_dependents();
-            }
-        }
+        onExecuted = f;
+    }
+    void clearOnExecuted()
+    {
+        onExecuted = std::function<void(exec_node*)>();
     }
 
     /**
-     * @brief emplace
-     * @param __args
+     * @brief setOnResourceAvailable
+     * @param f
      *
-     * Construct the resource in place
+     * Called on the producing thread when a resource becomes available,
+     * before its dependents are notified. Used for tracing.
      */
-    template<typename... _Args>
-    void emplace(_Args&&... __args)
+    void setOnResourceAvailable( std::function<void(resource_node*)> f)
     {
-      typedef typename std::remove_const<T>::type Node_t;
-
-      m_node.lock()->get_resource().emplace<T>( std::forward<_Args>(__args)...);
+        onResourceAvailable = f;
+    }
+    void clearOnResourceAvailable()
+    {
+        onResourceAvailable = std::function<void(resource_node*)>();
     }
 
     /**
-     * @brief set
-     * @param x
-     * @param make_avail
+     * @brief setOnPublish
+     * @param f
      *
-     * Sets the resource
+     * Replaces the way resources are made available and their dependents
+     * notified when a node publishes them. Used by the pipelined_executor,
+     * which tracks availability per frame.
      */
-    void set(T const & x, bool make_avail=true)
+    void setOnPublish( std::function<void(resource_node*)> f)
     {
-        m_node.lock()->get_resource() = x;
-        if( make_avail) make_available();
+        onPublish = f;
     }
-
-    void set(T && x, bool make_avail=true)
+    void clearOnPublish()
     {
-        m_node.lock()->get_resource() = std::move(x);
-        if( make_avail) make_available();
+        onPublish = std::function<void(resource_node*)>();
     }
 
-
-
-
-    //============================================================================
-    // Allows allow using -> if T is a pointer
-    //============================================================================
-    template< typename U=T >
-    typename std::enable_if< std::is_same<T,U>::value && is_pointer_type, U&>::type
-    operator->()
+    /**
+     * @brief setOnSpawn
+     * @param f
+     *
+     * Called by parallel nodes to hand a helper task to the thread pool.
+     * The task must be executed exactly once. Return false to refuse the
+     * task, in which case the remaining chunks are executed by the thread
+     * running the node.
+     */
+    void setOnSpawn( std::function<bool(std::function<void(void)>&)> f)
     {
-        return get();
+        onSpawn = f;
     }
-
-
-    template<
-    typename U = T,
-    typename = typename std::enable_if< std::is_same<T,U>::value >::type>
-    operator U() {
-        return get();
+    void clearOnSpawn()
+    {
+        onSpawn = std::function<bool(std::function<void(void)>&)>();
     }
 
-    //============================================================================
-    // Allows dereferencing if T is a fundamental type:
-    //============================================================================
-    T & operator*()
+    /**
+     * @brief get_num_spawned
+     * @return
+     *
+     * Returns the number of helper tasks handed to onSpawn which have not
+     * yet returned. Helpers may still be queued after the frame has
+     * finished, so the thread pool must not be destroyed while this is
+     * non-zero.
+     */
+    uint32_t get_num_spawned() const
     {
-        return get();
+        return m_numSpawned.load(std::memory_order_acquire);
     }
-};
+protected:
 
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena;  // only used when constructed with an arena size
+    std::pmr::memory_resource                          * m_memory;
 
+    std::pmr::vector< exec_node_p >        m_exec_nodes{m_memory};
+    resource_name_table                    m_names{m_memory};
+    std::pmr::vector< resource_node_p >    m_resources{m_memory}; // indexed by the id of the resource's name
+    compiled_graph                         m_plan;
 
+    /**
+     * @brief assign_transients
+     *
+     * Marks the resetable resources of the compiled plan which have a
+     * producer and at least one consumer as transient, and packs their
+     * storage into slots. A resource is placed in a slot if every consumer
+     * of the slot's last occupant is an ancestor of its producer. Slots
+     * with more than one occupant are allocated from the transient pool.
+     */
+    void assign_transients()
+    {
+        release_transients();
+        if( !m_transient_aliasing )
+            return;
 
-class ResourceRegistry
-{
-    std::map<std::string, resource_node_p> & m_resources;
-    std::vector<resource_node_w> & m_required_resources;
-    exec_node_p & m_Node;
+        auto & P = m_plan;
+        auto N = P.nodes.size();
+        auto M = P.resources.size();
 
-    public:
-        ResourceRegistry( exec_node_p & node,
-                          std::map<std::string, resource_node_p> & m,
-                          std::vector<resource_node_w> & required_resources) :
-            m_Node(node),
-            m_resources(m),
-            m_required_resources(required_resources)
+        std::vector<int64_t>  producer(M, -1);
+        std::vector<uint32_t> consumers(M, 0);
+        for(uint32_t i=0; i < N; ++i)
         {
-
+            for(auto k = P.node_output_offsets[i]; k < P.node_output_offsets[i+1]; ++k)
+                producer[ P.node_outputs[k] ] = i;
+            for(auto k = P.node_input_offsets[i]; k < P.node_input_offsets[i+1]; ++k)
+                ++consumers[ P.node_inputs[k] ];
         }
 
-        template<typename T, resource_flags F=resource_flags::resetable>
-        out_resource<T> register_output_resource(const std::string & name)
+        // ancestors of each node, one bit per node
+        auto words = (N + 63) / 64;
+        std::vector<uint64_t> ancestors(N * words, 0);
+        for(uint32_t i=0; i < N; ++i)
         {
-            if( m_resources.count(name) == 0 )
-            {
-                resource_node_p RN = std::make_shared< resource_node >();
-
-                RN->m_name     = name;
-                RN->m_flags    = F;
-
-                RN->m_parent = m_Node;
-
-                m_Node->m_producedResources.push_back(RN);
-                m_resources[name] = RN;
-
-                out_resource<T> r;
-                r.m_node = RN;
-
-                return r;
-            }
-            else
+            for(auto k = P.node_input_offsets[i]; k < P.node_input_offsets[i+1]; ++k)
             {
-                out_resource<T> r;
-
-
-                r.m_node = m_resources.at(name);
-                if(r.m_node.lock()->m_flags != F)
-                {
-                    throw std::runtime_error(std::string("Resource ") + name + std::string(" previously registered as different type") );
-                }
-                m_Node->m_producedResources.push_back( r.m_node);
-
-                return r;
+                auto p = producer[ P.node_inputs[k] ];
+                if( p < 0 )
+                    continue;
+                if( static_cast<uint32_t>(p) >= i )
+                    return; // the graph has a cycle
+                for(std::size_t w=0; w < words; ++w)
+                    ancestors[i*words + w] |= ancestors[p*words + w];
+                ancestors[i*words + p/64] |= uint64_t(1) << (p%64);
             }
         }
-
-        template<typename T, resource_flags F=resource_flags::resetable>
-        in_resource<T> register_input_resource(const std::string & name)
+        auto is_ancestor = [&](uint32_t a, uint32_t b)
         {
-            if( m_resources.count(name) == 0 )
-            {
-                resource_node_p RN = std::make_shared<resource_node>();
-
-                RN->m_Nodes.push_back(m_Node);
-                RN->m_name = name;
-                RN->m_flags = F;
-                m_resources[name] = RN;
-
-                in_resource<T> r;
-                r.m_node = RN;
+            return (ancestors[b*words + a/64] >> (a%64)) & 1;
+        };
 
-                m_required_resources.push_back(RN);
+        struct slot
+        {
+            std::size_t size   = 0;
+            std::size_t align  = 1;
+            std::size_t offset = 0;
+            uint32_t    last   = 0; // the resource which used the slot last
+            uint32_t    count  = 0;
+        };
+        std::vector<slot>     slots;
+        std::vector<int64_t>  slot_of(M, -1);
+        std::vector<uint32_t> waits(N, 0);
 
-                return r;
-            }
-            else
+        for(uint32_t p=0; p < N; ++p)
+        {
+            for(auto k = P.node_output_offsets[p]; k < P.node_output_offsets[p+1]; ++k)
             {
-                resource_node_p RN = m_resources[name];
-                RN->m_Nodes.push_back(m_Node);
-
-                in_resource<T> r;
-                r.m_node = RN;
-                if(r.m_node.lock()->m_flags != F)
+                auto r = P.node_outputs[k];
+                auto R = P.resources[r];
+                if( R->m_flags != resource_flags::resetable || !R->m_type || R->m_num_versions != 1 || consumers[r] == 0 )
+                    continue;
+
+                R->m_transient     = true;
+                R->m_num_consumers = consumers[r];
+                R->m_consumers_left.store(consumers[r], std::memory_order_relaxed);
+                m_has_transients   = true;
+
+                // best fit among the slots whose last occupant is dead before p starts
+                auto need = R->m_type->size;
+                int64_t best = -1;
+                for(std::size_t s=0; s < slots.size(); ++s)
                 {
-                    throw std::runtime_error(std::string("Resource ") + name + std::string(" previously registered as different type") );
+                    auto X  = slots[s].last;
+                    bool ok = true;
+                    for(auto c = P.resource_consumer_offsets[X]; ok && c < P.resource_consumer_offsets[X+1]; ++c)
+                        ok = is_ancestor(P.resource_consumers[c], p);
+                    if( !ok )
+                        continue;
+
+                    if( best < 0 )
+                    {
+                        best = static_cast<int64_t>(s);
+                        continue;
+                    }
+                    auto & B = slots[best];
+                    bool fits  = slots[s].size >= need;
+                    bool bfits = B.size >= need;
+                    if( (fits && (!bfits || slots[s].size < B.size)) || (!fits && !bfits && slots[s].size > B.size) )
+                        best = static_cast<int64_t>(s);
                 }
 
-                m_required_resources.push_back(RN);
-
-                return r;
+                if( best < 0 )
+                {
+                    best = static_cast<int64_t>(slots.size());
+                    slots.emplace_back();
+                }
+                else
+                {
+                    P.resources[ slots[best].last ]->m_next_occupant = P.nodes[p];
+                    ++waits[p];
+                }
+                auto & S = slots[best];
+                S.size  = std::max(S.size, need);
+                S.align = std::max(S.align, R->m_type->align);
+                S.last  = r;
+                ++S.count;
+                slot_of[r] = best;
             }
         }
-};
-
-
-class node_graph
-{
-public:
-    node_graph() {}
-    ~node_graph()
-    {
 
-        std::sort( m_exec_nodes.begin(), m_exec_nodes.end(),
-                   [](exec_node_p & l, exec_node_p & r)
+        std::size_t size  = 0;
+        std::size_t align = alignof(std::max_align_t);
+        for(auto & S : slots)
         {
-            return l->m_exec_start_time_us < r->m_exec_start_time_us;
-        });
+            if( S.count < 2 )
+                continue;
+            S.offset = (size + S.align - 1) / S.align * S.align;
+            size     = S.offset + S.size;
+            align    = std::max(align, S.align);
+        }
 
-        for(auto & e : m_exec_nodes)
+        if( size )
         {
-            //std::cout << e->get_name() << " use count: " << e.use_count() << "  time: " << e->m_exec_start_time_us.count() << std::endl;
+            m_transient_pool       = m_memory->allocate(size, align);
+            m_transient_pool_size  = size;
+            m_transient_pool_align = align;
+            for(uint32_t r=0; r < M; ++r)
+            {
+                if( slot_of[r] < 0 || slots[ slot_of[r] ].count < 2 )
+                    continue;
+                auto R = P.resources[r];
+                R->alias( static_cast<unsigned char*>(m_transient_pool) + slots[ slot_of[r] ].offset );
+                P.transient_bytes += R->m_type->size;
+            }
+            P.transient_pool_bytes = size;
         }
 
-        while(m_exec_nodes.size())
+        for(uint32_t i=0; i < N; ++i)
         {
-            m_exec_nodes.pop_back();
+            P.nodes[i]->m_alias_waits = waits[i];
+            P.nodes[i]->m_pending    += waits[i];
         }
     }
 
-    node_graph( node_graph const & other) = delete;
-    node_graph( node_graph && other) = delete;
-    node_graph & operator = ( node_graph const & other) = delete;
-    node_graph & operator = ( node_graph && other) = delete;
-
-
-    template<typename _Tp, typename... _Args>
     /**
-     * @brief add_oneshot_node
-     * @param __args
-     * @return
+     * @brief release_transients
      *
-     * Add a one-shot node to the graph. A one-shot node only executes once.
-     *
-     * A one-shot nodemay only register "permanent" resources.
+     * Undoes assign_transients(): every resource gets its own storage
+     * again and the transient pool is freed.
      */
-    inline exec_node & add_oneshot_node(_Args&&... __args)
+    void release_transients()
     {
-        return add_node_flags<node_flags::execute_once,_Tp>( std::forward<_Args>(__args)... );
+        for(auto & n : m_exec_nodes)
+        {
+            n->m_pending    -= n->m_alias_waits;
+            n->m_alias_waits = 0;
+        }
+        for(auto & R : m_resources)
+        {
+            R->unalias();
+            R->m_transient     = false;
+            R->m_next_occupant = nullptr;
+        }
+        if( m_transient_pool )
+            m_memory->deallocate(m_transient_pool, m_transient_pool_size, m_transient_pool_align);
+        m_transient_pool = nullptr;
+        m_transient_pool_size  = 0;
+        m_has_transients = false;
     }
 
     /**
-     * @brief add_node
-     * @param __args
-     * @return
+     * @brief node_done
      *
-     * Add a regular exec node to the graph
+     * Called once for every scheduled node after it has executed and
+     * scheduled its dependents. The thread which brings the count to
+     * zero finishes the frame, so onFinished is called exactly once.
      */
-    template<typename _Tp, typename... _Args>
-    inline exec_node & add_node(_Args&&... __args)
+    void node_done()
     {
-        return add_node_flags<node_flags::execute_multiple,_Tp>( std::forward<_Args>(__args)... );
+        if( m_numToExecute.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+        {
+            if(onFinished)
+                onFinished();
+#if defined(__cpp_lib_atomic_wait)
+            // wait() and is_idle() only see the frame as finished once the
+            // last store is made, so the waiter cannot return (and destroy
+            // the graph) while notify_all() is still using m_idle
+            m_idle.store(idle_state::finishing, std::memory_order_release);
+            m_idle.notify_all();
+            m_idle.store(idle_state::idle, std::memory_order_release);
+#else
+            // notify under the lock so the waiter cannot return (and
+            // destroy the graph) before we are done with the cv
+            std::lock_guard<std::mutex> L(m_idle_lock);
+            m_idle.store(idle_state::idle, std::memory_order_release);
+            m_idle_cv.notify_all();
+#endif
+        }
     }
+
     /**
-     * @brief AddNode
-     * @param __args
+     * @brief The continuation struct
      *
-     * Add a node to the Graph. The template class _Tp must contain a struct
-     * named Data_t.
+     * The node a thread will execute next, once the node it is currently
+     * executing for graph returns.
      */
-    template<node_flags F, typename _Tp, typename... _Args>
-    inline exec_node & add_node_flags(_Args&&... __args)
+    struct continuation
     {
-      typedef typename std::remove_const<_Tp>::type Node_t;
-
-      exec_node_p N   = std::make_shared<exec_node>();
+        node_graph const * graph = nullptr;
+        exec_node        * next  = nullptr;
+    };
 
-      N->m_flags = F;
-      ResourceRegistry R(N,  m_resources,  N->m_requiredResources);
-
-      N->m_NodeClass.emplace<Node_t>( R, std::forward<_Args>(__args)...);
-
-      N->m_name      = typeid( _Tp).name();// "Node_" + std::to_string(global_count++);
-      exec_node* rawp = N.get();
-      rawp->m_Graph  = this;
-
-      // Create the functor which will execute the
-      // Node's operator(data_t &d) method.
-      N->execute = [rawp]()
-      {
-          if( !rawp->m_executed ) // if we haven't executed yet.
-          {
+    static continuation & this_thread_continuation()
+    {
+        thread_local continuation C;
+        return C;
+    }
 
-              if( rawp->m_mutex.try_lock() ) // try to lock the mutex
-              {                              // if we have acquired the lock, execute the node
+    bool                  m_profiling    = false;
+    bool                  m_inline_continuation = false;
+    bool                  m_incremental  = false;
+    bool                  m_transient_aliasing = false;
+    bool                  m_has_transients = false;  // the compiled plan has transient resources
+    void                * m_transient_pool = nullptr;
+    std::size_t           m_transient_pool_size  = 0;
+    std::size_t           m_transient_pool_align = 1;
+    std::atomic<uint32_t> m_numRunning{0};
+    std::atomic<uint32_t> m_numSkipped{0};
+    std::atomic<uint32_t> m_numToExecute{0};
+    std::atomic<uint32_t> m_numSpawned{0};   // helper tasks of parallel nodes which have not returned
+    struct idle_state
+    {
+        static constexpr uint32_t running   = 0; // a frame started by trigger_all() is executing
+        static constexpr uint32_t finishing = 1; // the frame has finished, its waiters are being notified
+        static constexpr uint32_t idle      = 2;
+    };
+    std::atomic<uint32_t> m_idle{idle_state::idle};
+#if !defined(__cpp_lib_atomic_wait)
+    std::mutex              m_idle_lock;
+    std::condition_variable m_idle_cv;
+#endif
 
-                  auto graph = rawp->m_Graph;
-                  rawp->m_executed = true;
-                  rawp->m_exec_start_time_us = std::chrono::system_clock::now();
-                  rawp->m_thread_id = std::this_thread::get_id();
-                  //======== Exectue ========================
-                  std::any_cast< Node_t&>( rawp->m_NodeClass )();
-                  //==========================================
+   friend class exec_node;
+   friend class parallel_exec_node;
+   friend class async_exec_node;
+   friend class resource_node;
+   template<typename> friend class pipelined_executor;
+
+   std::function<void(exec_node*)>      onSchedule;
+   std::function<void(void)>            onFinished;
+   std::function<void(exec_node*)>      onExecuted;
+   std::function<void(resource_node*)>  onResourceAvailable;
+   std::function<bool(std::function<void(void)>&)> onSpawn;
+   std::function<void(resource_node*)>  onPublish;
+};
 
-                  --rawp->m_Graph->m_numToExecute;
-                  rawp->m_mutex.unlock();
+inline void exec_node::run()
+{
+    if( !m_Graph->m_inline_continuation )
+    {
+        run_once();
+        return;
+    }
 
-                  for(auto & r : rawp->m_producedResources)
-                  {
-                    auto R = r.lock();
+    auto & C    = node_graph::this_thread_continuation();
+    auto   prev = C;
+    C.graph = m_Graph;
+    C.next  = nullptr;
 
-                    if( !R->is_available() )
-                    {
-                        throw std::runtime_error( std::string("Node ") + rawp->get_name() + std::string(" failed to create resource: ") + R->get_name());
-                    }
-                  }
+    run_once();
+    while( auto N = C.next )
+    {
+        C.next = nullptr;
+        N->run_once();
+    }
 
-                  if( !graph->busy() )
-                  {
-                    if(graph->onFinished)
-                    {
-                        graph->onFinished();
-                    }
-                  }
-              }
-          }
-      };
+    C = prev;
+}
 
-      if( F == node_flags::execute_once)
-      {
-          for( auto & r : N->m_producedResources)
-          {
-              auto R = r.lock();
-              if( R->get_flags() != resource_flags::permanent )
-              {
+inline void exec_node::run_once()
+{
+    if( !m_executed.exchange(true) ) // make sure we only execute once
+    {
+        if( m_Graph->m_incremental )
+        {
+            if( m_incremental && inputs_unchanged() )
+            {
+                skip();
+                return;
+            }
+            record_inputs();
+        }
 
-                throw std::runtime_error( std::string("Node, set as ExecuteOnce, but produces resettable resource, ") + R->get_name() + std::string(". Nodes set as ExecuteOnce may only produce permenant resources.") );
-              }
-          }
-      }
+        if( m_cache && cache_lookup() )
+            return;
 
-      //std::any_cast< Node_t&>(N->m_NodeClass).registerResources( std::any_cast< Data_t&>( rawp->m_NodeData ), R);
+        m_Graph->m_numRunning.fetch_add(1, std::memory_order_relaxed);
+        m_exec_start_time_us = clock::now();
+        m_thread_id = std::this_thread::get_id();
 
-      m_exec_nodes.push_back(N);
+        if( m_parallel )
+        {
+            // finish_run() is called by whichever thread executes the last chunk
+            static_cast<parallel_exec_node*>(this)->start();
+            return;
+        }
 
-      return *N;
-    }
+        if( m_start )
+        {
+            // the node may suspend, finish_run() is called when it completes
+            m_start(this);
+            return;
+        }
 
-    /**
-     * @brief schedule_node
-     * @param p
-     *
-     * Schedules this node for execution.
-     */
-    void schedule_node( exec_node * p)
-    {
-        ++m_numToExecute;
-        if(onSchedule)
-            onSchedule(p);
+        //======== Exectue ========================
+        m_invoke(m_NodeClass);
+        //==========================================
+        finish_run();
     }
+}
 
-    /**
-     * @brief Reset
-     * @param destroy_resources - destroys all the resources as well. Default is false.
-     */
-    void reset(bool destroy_resources = false)
+inline void exec_node::finish_run()
+{
+    auto graph = m_Graph;
+    m_exec_end_time_us = clock::now();
+    if( graph->m_profiling )
+        m_stats.record( get_duration() );
+    if( graph->onExecuted )
+        graph->onExecuted(this);
+    if( m_cache && m_cache->m_miss )
+        cache_store();
+
+    // schedule the dependents before this node stops counting
+    // towards the frame, otherwise the frame could be seen as
+    // finished while there are still nodes to run.
+    check_outputs();
+    release_inputs();
+
+    graph->m_numRunning.fetch_sub(1, std::memory_order_relaxed);
+    graph->node_done();
+}
+
+inline void parallel_exec_node::start()
+{
+    if( m_prepare )
+        m_prepare(m_NodeClass);
+
+    auto size  = m_size(m_NodeClass);
+    auto chunk = std::max<std::size_t>(1, m_chunk_size(m_NodeClass));
+    auto n     = static_cast<uint64_t>( (size + chunk - 1) / chunk );
+
+    if( n == 0 )
     {
-        //std::cout << "size: " << m_exec_nodes.size() << std::endl;
-        m_exec_nodes.erase(std::remove_if(m_exec_nodes.begin(),
-                                  m_exec_nodes.end(),
-                                  [](exec_node_p & x)
-                                  {
+        finish();
+        return;
+    }
 
-                                      if(x->get_flags() == node_flags::execute_once && x->m_executed)
-                                      {
-                                          x->m_executed  = false;
-                                          x->m_scheduled = false;
-                                          x.reset();
-                                          return true;
-                                      }
-                                      x->m_executed  = false;
-                                      x->m_scheduled = false;
-                                      return false;
-                                  }),
-                   m_exec_nodes.end());
-//        std::cout << "size: " << m_exec_nodes.size() << std::endl;
+    m_range_size  = size;
+    m_range_chunk = chunk;
+    m_chunks_left.store( static_cast<uint32_t>(n), std::memory_order_relaxed);
+    m_claim.store( n << 32, std::memory_order_release);
 
-        for(auto & N : m_resources)
+    auto graph = m_Graph;
+    if( graph->onSpawn )
+    {
+        static const uint64_t max_helpers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        auto helpers = std::min<uint64_t>(n - 1, max_helpers);
+        for(uint64_t i=0; i < helpers; ++i)
         {
-            if( N.second->get_flags() != resource_flags::permanent)
+            graph->m_numSpawned.fetch_add(1, std::memory_order_relaxed);
+            if( !graph->onSpawn(help) )
             {
-                N.second->make_available(false);
+                graph->m_numSpawned.fetch_sub(1, std::memory_order_relaxed);
+                break;
             }
         }
     }
 
+    run_chunks();
+}
 
-    resource_node_p  get_resources(std::string const & name)
+inline void parallel_exec_node::run_chunks()
+{
+    uint32_t done = 0;
+    for(;;)
     {
-        return m_resources.at(name);
+        auto v = m_claim.fetch_add(1, std::memory_order_acq_rel);
+        auto i = static_cast<uint32_t>(v);
+        auto n = static_cast<uint32_t>(v >> 32);
+        if( i >= n )
+            break;
+
+        auto b = static_cast<std::size_t>(i) * m_range_chunk;
+        auto e = std::min(b + m_range_chunk, m_range_size);
+        m_invoke_range(m_NodeClass, b, e);
+        ++done;
     }
 
-    void print_info()
+    if( done && m_chunks_left.fetch_sub(done, std::memory_order_acq_rel) == done )
     {
-        std::cout << "Num Nodes: " << m_exec_nodes.size() << std::endl;
-        std::cout << "Num Resources: " << m_resources.size() << std::endl;
-        std::cout << "Num Running: " << m_numRunning << std::endl;
-        std::cout << "Num To Executing: " << m_numToExecute << std::endl;
+        finish();
     }
+}
 
+inline void parallel_exec_node::finish()
+{
+    publish_outputs();
+    finish_run();
+}
 
-    void print_node_resource_order(exec_node_p & e)
+inline void parallel_exec_node::run_inline()
+{
+    if( m_prepare )
+        m_prepare(m_NodeClass);
+
+    auto size  = m_size(m_NodeClass);
+    auto chunk = std::max<std::size_t>(1, m_chunk_size(m_NodeClass));
+    for(std::size_t b=0; b < size; b += chunk)
     {
-        for(auto & r : e->m_requiredResources)
+        m_invoke_range(m_NodeClass, b, std::min(b + chunk, size));
+    }
+    publish_outputs();
+}
+
+inline void parallel_exec_node::publish_outputs()
+{
+    if( m_finish )
+        m_finish(m_NodeClass);
+
+    auto publish = [](resource_node * R)
+    {
+        if( R->has_value() )
         {
-            std::cout << r.lock()->get_name() << " -> " << e->get_name() << std::endl;
+            R->bump_revision();
+            R->publish();
         }
-        for(auto & r : e->m_producedResources)
+    };
+
+    if( m_Graph->is_compiled() )
+    {
+        auto & P = m_Graph->get_plan();
+        for(auto i = P.node_output_offsets[m_index]; i < P.node_output_offsets[m_index+1]; ++i)
+            publish( P.resources[ P.node_outputs[i] ] );
+    }
+    else
+    {
+        for(auto & r : m_producedResources)
         {
-            std::cout << e->get_name() << " -> " << r.lock()->get_name() << std::endl;
+            if( auto R = r.lock() )
+                publish( R.get() );
         }
-        if( e->m_producedResources.size()==0) return;
-
-        //std::cout << e->m_name <<( e->m_producedResources.size()==0?"\n":" -> ");
-
     }
+}
 
-    void print_node(resource_node_p & N, time_point start)
+inline void exec_node::trigger()
+{
+    if( can_execute() )
     {
-        std::cout << "{\n";
-        std::cout << "    rank=same \n";
-        std::cout << "    " << N->get_name() << "[shape=circle style=filled  color=\"0.650 0.700 0.700\"]\n";
-        if(N->get_time(start).count() != 0) std::cout << "    " << N->get_time(start).count() << "\n";
-        std::cout << "}" << std::endl;;
+        if( !m_scheduled.exchange(true, std::memory_order_acq_rel) )
+        {
+            m_Graph->schedule_node(this);
+        }
     }
+}
 
-    void print_node(exec_node_p & N, time_point start)
+inline void exec_node::resource_available(bool permanent)
+{
+    if( permanent )
     {
-        std::cout << "{\n";
-        std::cout << "    rank=same \n";
-        std::cout << "    " << N->get_name() << "[shape=square]\n";
-        if(N->get_time(start).count() != 0) std::cout << "    " << N->get_time(start).count() << "\n";
-        std::cout << "}" << std::endl;;
+        // the resource will remain available after reset()
+        --m_initial_pending;
     }
-
-    /**
-     * @brief print
-     *
-     * Prints the graph in dot format.
-     */
-    void print()
+    if( m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1 )
     {
+        if( !m_scheduled.exchange(true, std::memory_order_acq_rel) )
+        {
+            m_Graph->schedule_node(this);
+        }
+    }
+}
 
-        std::map<std::thread::id, int> threadProps;
-        std::map<time_point, int> nodes;
+inline void exec_node::check_outputs() const
+{
+    auto fail = [this](resource_node const & R)
+    {
+        throw std::runtime_error( std::string("Node ") + std::string(get_name()) + std::string(" failed to create resource: ") + std::string(R.get_name()));
+    };
 
-        auto min = m_exec_nodes[0]->get_time();
-        for(auto & E : m_exec_nodes)
+    if( m_Graph->is_compiled() )
+    {
+        auto & P = m_Graph->get_plan();
+        for(auto i = P.node_output_offsets[m_index]; i < P.node_output_offsets[m_index+1]; ++i)
         {
-            auto t = E->get_time();
-            min = std::min(min, t);
-            nodes[t]=0;
+            auto R = P.resources[ P.node_outputs[i] ];
+            if( !R->is_available() )
+                fail(*R);
         }
-        for(auto & E : m_resources)
-        {
+        return;
+    }
 
-            auto t = E.second->get_time();
-            if(E.second->get_flags() != resource_flags::permanent)
-            {
-                min    = std::min(min, t);
-            }
-            nodes[t]=0;
+    for(auto & r : m_producedResources)
+    {
+        auto R = r.lock();
+        if( R && !R->is_available() )
+            fail(*R);
+    }
+}
 
+inline bool exec_node::inputs_unchanged() const
+{
+    if( !m_has_run )
+        return false;
 
-        }
+    std::size_t i = 0;
+    bool unchanged = true;
+    for_each_input( [&](resource_node * R)
+    {
+        unchanged = unchanged && i < m_input_revisions.size() && R->get_revision() == m_input_revisions[i];
+        ++i;
+    });
+    if( !unchanged || i == 0 || i != m_input_revisions.size() )
+        return false;
 
-        std::cout << "digraph G {" << std::endl;
+    for_each_output( [&](resource_node * R)
+    {
+        unchanged = unchanged && R->has_value();
+    });
+    return unchanged;
+}
 
-        auto s = nodes.size();
-        for(auto & E : nodes)
-        {
-            auto t = std::chrono::duration_cast<std::chrono::microseconds>(E.first - min).count();
-            std::cout << t << (s==1? "\n":" -> ") ;
-            s--;
-        };
+inline void exec_node::record_inputs()
+{
+    m_input_revisions.clear();
+    for_each_input( [this](resource_node * R)
+    {
+        m_input_revisions.push_back( R->get_revision() );
+    });
+    m_has_run = true;
+}
 
+inline void exec_node::skip()
+{
+    auto graph = m_Graph;
+    for_each_output( [](resource_node * R)
+    {
+        R->publish();
+    });
+    graph->m_numSkipped.fetch_add(1, std::memory_order_relaxed);
+    release_inputs();
+    graph->node_done();
+}
 
-        for(auto & E : m_exec_nodes)
-        {
-            print_node(E,min);
-        }
-        for(auto & E : m_resources)
+inline void exec_node::release_inputs()
+{
+    if( !m_Graph->m_has_transients )
+        return;
+    for_each_input( [](resource_node * R)
+    {
+        if( R->m_transient && R->m_consumers_left.fetch_sub(1, std::memory_order_acq_rel) == 1 )
         {
-            print_node(E.second,min);
+            R->destroy();
+            if( R->m_next_occupant )
+                R->m_next_occupant->resource_available(false);
         }
+    });
+}
 
-        for(auto & E : m_exec_nodes)
-        {
-            print_node_resource_order(E);
-        }
+inline void exec_node::enable_cache(std::size_t max_bytes)
+{
+    auto check = [this](resource_node * R, bool ok, char const * what)
+    {
+        if( !ok )
+            throw std::runtime_error( std::string("Node ") + std::string(get_name()) + std::string(" cannot be cached, resource ")
+                                      + std::string(R->get_name()) + what );
+    };
+    for_each_input( [&](resource_node * R)
+    {
+        check(R, R->m_type && R->m_type->hash, " is not hashable");
+    });
+    for_each_output( [&](resource_node * R)
+    {
+        check(R, R->m_type && R->m_type->copy, " is not copy constructible");
+    });
+    m_cache = std::make_unique<node_cache>(max_bytes);
+}
 
+inline bool exec_node::cache_lookup()
+{
+    uint64_t key = 14695981039346656037ull;
+    for_each_input( [&](resource_node * R)
+    {
+        key ^= R->m_type->hash( R->get_data() ) + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+    });
 
-        std::cout << "}" << std::endl;
+    auto & C = *m_cache;
+    C.m_key  = key;
+    C.m_miss = !C.lookup(key);
+    if( C.m_miss )
+    {
+        C.discard_pending(); // left over if the node threw the last time it ran
+        return false;
     }
 
-    std::vector< exec_node_p > & get_exec_nodes()
+    auto graph = m_Graph;
+    for_each_output( [](resource_node * R)
     {
-        return m_exec_nodes;
-    }
+        R->bump_revision();
+        R->publish();
+    });
+    release_inputs();
+    graph->node_done();
+    return true;
+}
 
+inline void exec_node::cache_snapshot(resource_node * R)
+{
+    if( m_cache && m_cache->m_miss )
+        m_cache->snapshot(R);
+}
 
-    uint32_t get_num_running() const
+inline void exec_node::cache_store()
+{
+    auto & C = *m_cache;
+    C.m_miss = false;
+
+    std::size_t n = 0;
+    for_each_output( [&](resource_node *) { ++n; } );
+    C.store(C.m_key, n);
+}
+
+inline bool node_cache::lookup(uint64_t key)
+{
+    auto f = m_index.find(key);
+    if( f == m_index.end() )
+    {
+        ++m_stats.misses;
+        return false;
+    }
+    ++m_stats.hits;
+    m_lru.splice(m_lru.begin(), m_lru, f->second);
+    for(auto & v : f->second->values)
     {
-        return m_numRunning;
+        v.resource->assign_copy(v.data);
     }
+    return true;
+}
 
-    uint32_t get_left_to_execute() const
+inline void node_cache::snapshot(resource_node * R)
+{
+    auto T = R->m_type;
+    m_pending.bytes += T->bytes( R->get_data() );
+    if( m_pending.bytes > m_max_bytes )
+        return; // will not be stored, do not bother copying
+
+    auto p = ::operator new( T->size, std::align_val_t(T->align) );
+    T->copy( p, R->get_data() );
+    m_pending.values.push_back( value{R, T, p} );
+}
+
+inline void node_cache::store(uint64_t key, std::size_t num_outputs)
+{
+    auto bytes = m_pending.bytes;
+    if( bytes > m_max_bytes || m_pending.values.size() != num_outputs )
     {
-        return m_numToExecute;
+        discard_pending();
+        return;
     }
 
-    /**
-     * @brief busy
-     * @return
-     *
-     * Returns true if the graph is busy. Ie; There are nodes running
-     */
-    bool busy() const
+    auto f = m_index.find(key);
+    if( f != m_index.end() )
+        erase(f->second);
+
+    while( !m_lru.empty() && m_stats.bytes + bytes > m_max_bytes )
     {
-        return m_numRunning!=0 || m_numToExecute!=0;
+        erase( std::prev(m_lru.end()) );
+        ++m_stats.evictions;
     }
 
-    void setOnSchedule( std::function<void(exec_node*)> f)
+    m_pending.key = key;
+    m_lru.push_front( std::move(m_pending) );
+    m_index[key] = m_lru.begin();
+    m_stats.bytes += bytes;
+    m_stats.entries = m_lru.size();
+
+    m_pending = entry{0, 0, {}};
+}
+
+inline void node_cache::discard_pending()
+{
+    for(auto & v : m_pending.values)
+        free_value(v);
+    m_pending.values.clear();
+    m_pending.bytes = 0;
+}
+
+inline void node_cache::free_value(value & v)
+{
+    v.type->destroy(v.data);
+    ::operator delete( v.data, std::align_val_t(v.type->align) );
+}
+
+inline void node_cache::erase(std::list<entry>::iterator it)
+{
+    for(auto & v : it->values)
+        free_value(v);
+    m_stats.bytes -= it->bytes;
+    m_index.erase(it->key);
+    m_lru.erase(it);
+    m_stats.entries = m_lru.size();
+}
+
+inline void node_cache::clear()
+{
+    while( !m_lru.empty() )
+        erase( m_lru.begin() );
+}
+
+template<typename F>
+inline void exec_node::for_each_input(F && f) const
+{
+    if( m_Graph->is_compiled() )
     {
-        onSchedule = f;
+        auto & P = m_Graph->get_plan();
+        for(auto i = P.node_input_offsets[m_index]; i < P.node_input_offsets[m_index+1]; ++i)
+            f( P.resources[ P.node_inputs[i] ] );
+        return;
     }
-    void clearOnSchedule()
+    for(auto & r : m_requiredResources)
     {
-        onSchedule = std::function<void(exec_node*)>();
+        if( auto R = r.lock() )
+            f( R.get() );
     }
+}
 
-    void setOnComplete( std::function<void(void)> f)
+template<typename F>
+inline void exec_node::for_each_output(F && f) const
+{
+    if( m_Graph->is_compiled() )
     {
-        onFinished = f;
+        auto & P = m_Graph->get_plan();
+        for(auto i = P.node_output_offsets[m_index]; i < P.node_output_offsets[m_index+1]; ++i)
+            f( P.resources[ P.node_outputs[i] ] );
+        return;
     }
-    void clearOnComplete()
+    for(auto & r : m_producedResources)
     {
-        onFinished = std::function<void(void)> ();
+        if( auto R = r.lock() )
+            f( R.get() );
     }
-protected:
-
-    std::vector< exec_node_p >             m_exec_nodes;
-    std::map<std::string, resource_node_p> m_resources;
-
-    uint32_t m_numRunning   = 0;
-    uint32_t m_numToExecute = 0;
-
-   friend class exec_node;
-
-   std::function<void(exec_node*)>  onSchedule;
-   std::function<void(void)>        onFinished;
-};
+}
 
-inline void exec_node::trigger()
+inline void resource_node::publish()
 {
-    if( can_execute() )
+    if( m_Graph && m_Graph->onPublish )
     {
-        if(!m_scheduled)
-        {
-            m_scheduled = true;
-            m_Graph->schedule_node(this);
-        }
+        m_Graph->onPublish(this);
+        return;
+    }
+    if( try_make_available() )
+    {
+        if( m_producer )
+            m_producer->cache_snapshot(this);
+        notify_dependents();
     }
 }
 
-inline bool exec_node::can_execute() const
+inline void resource_node::notify_dependents()
 {
-    for(auto & R : m_requiredResources)
+    bool permanent = m_flags == resource_flags::permanent;
+
+    if( m_Graph && m_Graph->onResourceAvailable )
+        m_Graph->onResourceAvailable(this);
+
+    if( m_Graph && m_Graph->is_compiled() )
     {
-        auto r = R.lock();
-        if( r )
+        auto & P = m_Graph->get_plan();
+        for(auto i = P.resource_consumer_offsets[m_index]; i < P.resource_consumer_offsets[m_index+1]; ++i)
         {
-            if( !r->is_available() )
-            {
-                return false;
-            }
-        } else {
-            return false;
+            P.nodes[ P.resource_consumers[i] ]->resource_available(permanent);
         }
+        return;
+    }
+
+    for(auto & N : m_Nodes)
+    {
+        if( auto n = N.lock())
+            n->resource_available(permanent);
     }
-    return true;
 }
 
 }
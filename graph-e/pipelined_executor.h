@@ -0,0 +1,415 @@
+#pragma once
+
+#ifndef PIPELINED_EXECUTE_GRAPH_3_H
+#define PIPELINED_EXECUTE_GRAPH_3_H
+
+#include "node_graph.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace graphe
+{
+
+/**
+ * @brief The pipelined_executor class
+ *
+ * Executes several frames of a graph at once on a thread pool. Up to
+ * depth frames may be in flight: frame f uses slot f % depth, and every
+ * resource holds one version per slot, so the nodes of frame f+1 can
+ * run while frame f is still finishing.
+ *
+ * A node of frame f is executed once its inputs for frame f are
+ * available and its instance of frame f-1 has finished, so a node is
+ * never executed by two threads at once and the Node class may keep
+ * state between frames. Permanent resources have a single version, so
+ * they may only be written by nodes flagged execute_once, which are
+ * only executed in the first frame.
+ *
+ * The graph is compiled if it has not been. The executor keeps its own
+ * state per frame, so node_graph::reset() is not needed between frames.
+ * Parallel nodes are executed as a single task. Asynchronous nodes are
+ * not supported. Transient resources get their own storage while the
+ * executor exists (see node_graph::set_transient_aliasing()).
+ *
+ *   pipelined_executor<ThreadPoolWrapper> Exec(G, 3);
+ *   Exec.set_thread_pool(&TW);
+ *
+ *   for(int i=0;i<100;i++)
+ *       Exec.execute(); // blocks while 3 frames are in flight
+ *   Exec.wait();
+ */
+template<typename ThreadPool_t>
+class pipelined_executor
+{
+public:
+    pipelined_executor(node_graph & graph, uint32_t depth = 2) :
+        m_graph(graph),
+        m_depth( std::max<uint32_t>(1, depth) )
+    {
+        if( !graph.is_compiled() )
+            graph.compile();
+
+        auto & P = graph.get_plan();
+        for(auto N : P.nodes)
+        {
+            if( N->m_start )
+                throw std::runtime_error( std::string("Node ") + std::string(N->get_name()) + std::string(" is asynchronous, which the pipelined_executor does not support") );
+
+            // a permanent resource has a single version, shared by every
+            // frame in flight, so only a one-shot node may write it
+            if( N->get_flags() == node_flags::execute_once )
+                continue;
+            for(auto & r : N->m_producedResources)
+            {
+                auto R = r.lock();
+                if( R->get_flags() == resource_flags::permanent )
+                    throw std::runtime_error( std::string("Node ") + std::string(N->get_name()) + std::string(" writes the permanent resource ") + std::string(R->get_name()) + std::string(" every frame, which the pipelined_executor does not support") );
+            }
+        }
+
+        m_num_nodes     = static_cast<uint32_t>( P.nodes.size() );
+        m_num_resources = static_cast<uint32_t>( P.resources.size() );
+
+        // nodes are invoked directly, without the graph's alias waits or
+        // the release of their inputs, so transient resources must not
+        // share storage, whatever the depth
+        graph.release_transients();
+        for(auto R : P.resources)
+            R->set_num_versions(m_depth);
+
+        // A node can only execute if each of its inputs is produced by a
+        // node which can execute, or is a permanent resource which is
+        // already available. The plan is in topological order.
+        std::vector<int64_t> producer(m_num_resources, -1);
+        for(uint32_t i=0; i < m_num_nodes; ++i)
+        {
+            for(auto k = P.node_output_offsets[i]; k < P.node_output_offsets[i+1]; ++k)
+                producer[ P.node_outputs[k] ] = i;
+        }
+
+        m_initial.assign(m_num_nodes, 0);
+        m_live.assign(m_num_nodes, false);
+        m_num_live = 0;
+        for(uint32_t i=0; i < m_num_nodes; ++i)
+        {
+            bool live = true;
+            for(auto k = P.node_input_offsets[i]; k < P.node_input_offsets[i+1]; ++k)
+            {
+                auto r = P.node_inputs[k];
+                auto R = P.resources[r];
+                bool ok = ( producer[r] >= 0 && m_live[ producer[r] ] ) ||
+                          ( R->get_flags() == resource_flags::permanent && R->is_available() );
+                live = live && ok;
+            }
+            m_live[i]   = live;
+            m_num_live += live;
+        }
+
+        m_pending.reset(   new std::atomic<uint32_t>[ m_depth * m_num_nodes ] );
+        m_available.reset( new std::atomic<bool>[ m_depth * m_num_resources ] );
+        m_remaining.reset( new std::atomic<uint32_t>[ m_depth ] );
+        m_slot_frame.reset(new std::atomic<uint64_t>[ m_depth ] );
+        m_finished.reset(  new std::atomic<uint64_t>[ m_num_nodes ] );
+        m_scheduled.reset( new std::atomic<uint64_t>[ m_num_nodes ] );
+        m_slot_busy.assign(m_depth, false);
+
+        for(uint32_t s=0; s < m_depth; ++s)
+        {
+            m_remaining[s]  = 0;
+            m_slot_frame[s] = no_frame;
+        }
+        for(uint32_t i=0; i < m_num_nodes; ++i)
+        {
+            m_finished[i]  = 0;
+            m_scheduled[i] = 0;
+        }
+
+        m_tasks.reserve( m_depth * m_num_nodes );
+        for(uint32_t s=0; s < m_depth; ++s)
+        {
+            for(uint32_t i=0; i < m_num_nodes; ++i)
+            {
+                m_tasks.emplace_back(
+                [this, i, s]()
+                {
+                    run_node(i, s);
+                    m_outstanding.fetch_sub(1, std::memory_order_release);
+                });
+            }
+        }
+
+        graph.setOnPublish(
+        [this](resource_node * R)
+        {
+            publish(R);
+        });
+    }
+
+    ~pipelined_executor()
+    {
+        wait();
+        while( m_outstanding.load(std::memory_order_acquire) != 0 )
+            std::this_thread::yield();
+
+        m_graph.clearOnPublish();
+        for(auto R : m_graph.get_plan().resources)
+            R->set_num_versions(1);
+        m_graph.assign_transients();
+    }
+
+    void set_thread_pool(ThreadPool_t * T)
+    {
+        m_thread_pool = T;
+    }
+
+    ThreadPool_t * get_thread_pool() const
+    {
+        return m_thread_pool;
+    }
+
+    uint32_t get_depth() const
+    {
+        return m_depth;
+    }
+
+    /**
+     * @brief execute
+     * @return
+     *
+     * Starts the next frame and returns its number. Blocks while depth
+     * frames are already in flight, until the frame using the same slot
+     * has finished.
+     */
+    uint64_t execute()
+    {
+        auto   f  = m_next_frame++;
+        auto   s  = static_cast<uint32_t>( f % m_depth );
+
+        {
+            std::unique_lock<std::mutex> lk(m_lock);
+            m_cv.wait(lk, [&] { return !m_slot_busy[s]; } );
+            m_slot_busy[s] = true;
+        }
+
+        for(uint32_t i=0; i < m_num_nodes; ++i)
+        {
+            m_initial[i] = count_inputs(i, f);
+            m_pending[ s*m_num_nodes + i ].store( m_initial[i], std::memory_order_relaxed);
+        }
+        for(uint32_t r=0; r < m_num_resources; ++r)
+        {
+            m_available[ s*m_num_resources + r ].store(false, std::memory_order_relaxed);
+        }
+        m_remaining[s].store(m_num_live + 1, std::memory_order_relaxed); // +1 while the frame is being seeded
+        m_slot_frame[s].store(f, std::memory_order_seq_cst);
+
+        for(uint32_t i=0; i < m_num_nodes; ++i)
+        {
+            if( m_live[i] && m_initial[i] == 0 )
+                try_start(i, f);
+        }
+
+        if( m_remaining[s].fetch_sub(1, std::memory_order_acq_rel) == 1 )
+            frame_done(s);
+
+        return f;
+    }
+
+    /**
+     * @brief wait
+     *
+     * Blocks until every frame which has been started has finished.
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        m_cv.wait(lk, [this] { return m_completed == m_next_frame; } );
+    }
+
+    /**
+     * @brief frames_completed
+     * @return
+     *
+     * Returns the number of frames which have finished.
+     */
+    uint64_t frames_completed() const
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        return m_completed;
+    }
+
+private:
+    static constexpr uint64_t no_frame = ~uint64_t(0);
+
+    /**
+     * @brief count_inputs
+     *
+     * The number of inputs node i waits for in frame f. Permanent
+     * resources are only waited for in the first frame: in later frames
+     * the node's previous instance has already consumed them.
+     */
+    uint32_t count_inputs(uint32_t i, uint64_t f) const
+    {
+        auto & P = m_graph.get_plan();
+        uint32_t n = 0;
+        for(auto k = P.node_input_offsets[i]; k < P.node_input_offsets[i+1]; ++k)
+        {
+            auto R = P.resources[ P.node_inputs[k] ];
+            if( R->get_flags() != resource_flags::permanent )
+                ++n;
+            else if( f == 0 && !R->is_available() )
+                ++n;
+        }
+        return n;
+    }
+
+    /**
+     * @brief try_start
+     *
+     * Schedules node i for frame f if its previous instance has finished.
+     * Called once the inputs of frame f are available. If the previous
+     * instance has not finished, it schedules this one when it does.
+     */
+    void try_start(uint32_t i, uint64_t f)
+    {
+        if( m_finished[i].load(std::memory_order_seq_cst) >= f )
+            schedule(i, f);
+    }
+
+    void schedule(uint32_t i, uint64_t f)
+    {
+        // both the last input and the previous instance may try to
+        // schedule the node; only one of them succeeds.
+        auto expected = f;
+        if( !m_scheduled[i].compare_exchange_strong(expected, f+1, std::memory_order_acq_rel) )
+            return;
+
+        auto s = static_cast<uint32_t>( f % m_depth );
+        m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        m_thread_pool->operator()( m_tasks[ s*m_num_nodes + i ] );
+    }
+
+    void run_node(uint32_t i, uint32_t s)
+    {
+        auto & P = m_graph.get_plan();
+        auto   N = P.nodes[i];
+        auto   f = m_slot_frame[s].load(std::memory_order_acquire);
+
+        auto & V    = this_thread_resource_version();
+        auto   prev = V;
+        V = s;
+
+        if( N->get_flags() != node_flags::execute_once || f == 0 )
+        {
+            N->m_exec_start_time_us = clock::now();
+            N->m_thread_id          = std::this_thread::get_id();
+            //======== Exectue ========================
+            if( N->m_parallel )
+                static_cast<parallel_exec_node*>(N)->run_inline();
+            else
+                N->m_invoke(N->m_NodeClass);
+            //==========================================
+            N->m_exec_end_time_us = clock::now();
+
+            if( m_graph.m_profiling )
+                N->m_stats.record( N->get_duration() );
+            if( m_graph.onExecuted )
+                m_graph.onExecuted(N);
+
+            for(auto k = P.node_output_offsets[i]; k < P.node_output_offsets[i+1]; ++k)
+            {
+                auto r = P.node_outputs[k];
+                auto R = P.resources[r];
+                bool ok = R->get_flags() == resource_flags::permanent ? R->is_available()
+                                                                      : m_available[ s*m_num_resources + r ].load(std::memory_order_relaxed);
+                if( !ok )
+                    throw std::runtime_error( std::string("Node ") + std::string(N->get_name()) + std::string(" failed to create resource: ") + std::string(R->get_name()));
+            }
+        }
+
+        V = prev;
+
+        // the next instance of this node may now execute
+        m_finished[i].store(f+1, std::memory_order_seq_cst);
+        auto g  = f + 1;
+        auto s2 = static_cast<uint32_t>( g % m_depth );
+        if( m_slot_frame[s2].load(std::memory_order_seq_cst) == g &&
+            m_pending[ s2*m_num_nodes + i ].load(std::memory_order_seq_cst) == 0 )
+        {
+            schedule(i, g);
+        }
+
+        if( m_remaining[s].fetch_sub(1, std::memory_order_acq_rel) == 1 )
+            frame_done(s);
+    }
+
+    /**
+     * @brief publish
+     *
+     * Makes R available in the frame executed by the calling thread and
+     * notifies its consumers in that frame.
+     */
+    void publish(resource_node * R)
+    {
+        auto & P = m_graph.get_plan();
+        auto   s = this_thread_resource_version();
+        auto   f = m_slot_frame[s].load(std::memory_order_acquire);
+        auto   r = R->get_index();
+
+        if( R->get_flags() == resource_flags::permanent )
+        {
+            // consumers only wait for permanent resources in the first frame
+            if( !R->try_make_available() || f != 0 )
+                return;
+        }
+        else if( m_available[ s*m_num_resources + r ].exchange(true, std::memory_order_acq_rel) )
+        {
+            return;
+        }
+
+        for(auto k = P.resource_consumer_offsets[r]; k < P.resource_consumer_offsets[r+1]; ++k)
+        {
+            auto c = P.resource_consumers[k];
+            if( m_pending[ s*m_num_nodes + c ].fetch_sub(1, std::memory_order_seq_cst) == 1 && m_live[c] )
+                try_start(c, f);
+        }
+    }
+
+    void frame_done(uint32_t s)
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        m_slot_busy[s] = false;
+        ++m_completed;
+        m_cv.notify_all(); // under the lock, so wait() cannot return before we are done
+    }
+
+    node_graph                & m_graph;
+    ThreadPool_t              * m_thread_pool = nullptr;
+    uint32_t                    m_depth;
+    uint32_t                    m_num_nodes     = 0;
+    uint32_t                    m_num_resources = 0;
+    uint32_t                    m_num_live      = 0;
+    std::vector<bool>           m_live;              // nodes which can execute, see the constructor
+    std::vector<uint32_t>       m_initial;           // inputs of each node in the frame being started
+
+    std::unique_ptr<std::atomic<uint32_t>[]> m_pending;    // [slot][node] inputs not yet available
+    std::unique_ptr<std::atomic<bool>[]>     m_available;  // [slot][resource]
+    std::unique_ptr<std::atomic<uint32_t>[]> m_remaining;  // [slot] nodes left to execute
+    std::unique_ptr<std::atomic<uint64_t>[]> m_slot_frame; // [slot] the frame using the slot
+    std::unique_ptr<std::atomic<uint64_t>[]> m_finished;   // [node] number of frames the node has finished
+    std::unique_ptr<std::atomic<uint64_t>[]> m_scheduled;  // [node] number of frames the node has been scheduled for
+
+    std::vector< std::function<void(void)> > m_tasks;     // [slot][node] handed to the thread pool
+    std::atomic<uint32_t>       m_outstanding{0};
+
+    mutable std::mutex          m_lock;
+    std::condition_variable     m_cv;
+    std::vector<bool>           m_slot_busy;
+    uint64_t                    m_next_frame = 0;     // only used by the thread calling execute()
+    uint64_t                    m_completed  = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#pragma once
+
+#ifndef READY_QUEUE_GRAPH_3_H
+#define READY_QUEUE_GRAPH_3_H
+
+#include "node_graph.h"
+
+namespace graphe
+{
+
+/**
+ * @brief The schedule_policy enum
+ *
+ * The order in which an executor dispatches nodes which are ready to run.
+ */
+enum class schedule_policy
+{
+    fifo,          // nodes are executed in the order they become ready
+    critical_path  // the ready node with the longest remaining path (exec_node::get_priority()) is executed first
+};
+
+/**
+ * @brief The fifo_queue class
+ *
+ * A FIFO queue stored in a circular buffer which only grows, so once it
+ * has reached the working size of the graph, pushing and popping does
+ * not allocate. Not thread safe.
+ */
+template<typename T>
+class fifo_queue
+{
+public:
+    void push(T x)
+    {
+        if( m_size == m_items.size() )
+            grow();
+        m_items[ (m_head + m_size) % m_items.size() ] = x;
+        ++m_size;
+    }
+
+    /**
+     * @brief pop
+     * @return
+     *
+     * Removes and returns the item at the front of the queue. The queue must not be empty.
+     */
+    T pop()
+    {
+        auto x = m_items[m_head];
+        m_head = (m_head + 1) % m_items.size();
+        --m_size;
+        return x;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+
+    void reserve(std::size_t n)
+    {
+        while( m_items.size() < n )
+            grow();
+    }
+
+protected:
+    void grow()
+    {
+        std::vector<T> items( std::max<std::size_t>(16, m_items.size() * 2) );
+        for(std::size_t i=0; i < m_size; ++i)
+            items[i] = m_items[ (m_head + i) % m_items.size() ];
+        m_items.swap(items);
+        m_head = 0;
+    }
+
+    std::vector<T> m_items;
+    std::size_t    m_head = 0;
+    std::size_t    m_size = 0;
+};
+
+/**
+ * @brief The ready_queue class
+ *
+ * A max-heap of exec_nodes keyed on exec_node::get_priority(). Nodes with
+ * equal priority are popped in the order they were pushed. Not thread safe.
+ */
+class ready_queue
+{
+public:
+    void push(exec_node * n)
+    {
+        m_heap.push_back( entry{n->get_priority(), m_seq++, n} );
+        std::push_heap(m_heap.begin(), m_heap.end(), compare);
+    }
+
+    /**
+     * @brief pop
+     * @return
+     *
+     * Removes and returns the node with the highest priority. The queue must not be empty.
+     */
+    exec_node * pop()
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), compare);
+        auto n = m_heap.back().node;
+        m_heap.pop_back();
+        return n;
+    }
+
+    bool empty() const
+    {
+        return m_heap.empty();
+    }
+
+    std::size_t size() const
+    {
+        return m_heap.size();
+    }
+
+    void reserve(std::size_t n)
+    {
+        m_heap.reserve(n);
+    }
+
+protected:
+    struct entry
+    {
+        uint64_t    priority;
+        uint64_t    seq;
+        exec_node * node;
+    };
+
+    static bool compare(entry const & a, entry const & b)
+    {
+        // a has a lower priority than b
+        return a.priority < b.priority || (a.priority == b.priority && a.seq > b.seq);
+    }
+
+    std::vector<entry> m_heap;
+    uint64_t           m_seq = 0;
+};
+
+}
+
+#endif
@@ -4,6 +4,11 @@
 #define SERIAL_EXECUTE_GRAPH_3_H
 
 #include "node_graph.h"
+#include "ready_queue.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace graphe
 {
@@ -17,31 +22,102 @@ public:
         m_graph.setOnSchedule(
         [this](exec_node *N)
         {
-            m_ToExecute.push(N);
+            if( m_policy == schedule_policy::fifo )
+                m_ToExecute.push(N);
+            else
+                m_ready.push(N);
+        });
+
+        m_graph.setOnSpawn(
+        [this](std::function<void(void)> & task)
+        {
+            // helpers of parallel nodes, and asynchronous nodes resumed
+            // by a node, run on the calling thread
+            if( std::this_thread::get_id() == m_thread )
+                return false;
+
+            // an asynchronous node resumed by another thread (eg: the
+            // timer thread) is handed back to the thread in execute().
+            // Notify under the lock so execute() cannot return before
+            // we are done with the cv.
+            std::lock_guard<std::mutex> L(m_resumed_lock);
+            m_resumed.push(&task);
+            m_resumed_cv.notify_one();
+            return true;
         });
     }
 
+    ~serial_executor()
+    {
+        // a thread which resumed a node may not have returned from resume() yet
+        while( m_graph.get_num_spawned() != 0 )
+            std::this_thread::yield();
+    }
+
+    /**
+     * @brief set_policy
+     * @param p
+     *
+     * Sets the order in which ready nodes are executed. With
+     * schedule_policy::critical_path, the graph should be compiled.
+     */
+    void set_policy(schedule_policy p)
+    {
+        m_policy = p;
+    }
+
+    schedule_policy get_policy() const
+    {
+        return m_policy;
+    }
+
+    /**
+     * @brief execute
+     *
+     * Executes the graph on the calling thread and returns once the frame
+     * has finished. If asynchronous nodes are suspended, the thread
+     * sleeps until one of them is resumed, and continues it.
+     */
     void execute()
     {
-        for(auto & N : m_graph.get_exec_nodes()) // place all the nodes with no resource requirements onto the queue.
+        m_thread = std::this_thread::get_id();
+        m_graph.trigger_all(); // place all the nodes whose resources are available onto the queue.
+
+        for(;;)
         {
-            if( N->can_execute() )
+            // execute the all nodes in the queue.
+            // New nodes will be added
+            while( !m_ToExecute.empty() )
             {
-                m_graph.schedule_node(N.get());
+                m_ToExecute.pop()->run();
             }
-        }
-        // execute the all nodes in the queue.
-        // New nodes will be added
-        while( m_ToExecute.size() )
-        {
-            m_ToExecute.front()->execute();
-            m_ToExecute.pop();
+            while( !m_ready.empty() )
+            {
+                m_ready.pop()->run();
+            }
+            if( m_graph.is_idle() )
+                break;
+
+            std::function<void(void)> * task;
+            {
+                std::unique_lock<std::mutex> lk(m_resumed_lock);
+                m_resumed_cv.wait(lk, [this] { return !m_resumed.empty(); } );
+                task = m_resumed.pop();
+            }
+            (*task)();
         }
     }
 
 protected:
     node_graph                 & m_graph;
-    std::queue<exec_node*>       m_ToExecute;
+    fifo_queue<exec_node*>       m_ToExecute;
+    ready_queue                  m_ready;    // used with schedule_policy::critical_path
+    schedule_policy              m_policy = schedule_policy::fifo;
+
+    std::thread::id                          m_thread;       // the thread in execute()
+    std::mutex                               m_resumed_lock;
+    std::condition_variable                  m_resumed_cv;
+    fifo_queue<std::function<void(void)>*>   m_resumed;      // asynchronous nodes resumed by other threads
 
 };
 
@@ -4,12 +4,37 @@
 #define THREAD_POOL_EXECUTE_GRAPH_3_H
 
 #include "node_graph.h"
+#include "ready_queue.h"
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
 namespace graphe
 {
 
+/**
+ * @brief The wait_policy enum
+ *
+ * What the thread calling threaded_executor::wait() does while the
+ * graph is executing.
+ */
+enum class wait_policy
+{
+    block,       // sleep until the last node has executed
+    participate  // run ready nodes alongside the pool's workers until the graph has finished
+};
+
+/**
+ * @brief accepts_numa_hint
+ *
+ * True if a thread pool wrapper also accepts a NUMA node, ie: provides
+ * operator()(std::function<void(void)>&, int numa_node = -1). The
+ * threaded_executor then passes it exec_node::get_numa_node().
+ */
+template<typename T, typename = void>
+struct accepts_numa_hint : std::false_type {};
+template<typename T>
+struct accepts_numa_hint<T, std::void_t<decltype( std::declval<T&>()( std::declval<std::function<void(void)>&>(), 0 ) )> > : std::true_type {};
 
 template<typename ThreadPool_t>
 class threaded_executor
@@ -20,14 +45,92 @@ public:
         graph.setOnSchedule(
         [this](exec_node *N)
         {
-            m_thread_pool->operator()(N->execute);
+            if( m_inline_frame )
+            {
+                // the whole frame is executed by execute() on the calling thread
+                push_ready(N);
+                return;
+            }
+
+            if( m_policy == schedule_policy::fifo && m_wait_policy == wait_policy::block )
+            {
+                if constexpr( accepts_numa_hint<ThreadPool_t>::value )
+                    m_thread_pool->operator()(N->execute, N->get_numa_node());
+                else
+                    m_thread_pool->operator()(N->execute);
+                return;
+            }
+
+            bool wake;
+            {
+                std::lock_guard<std::mutex> L(m_ready_lock);
+                push_ready(N);
+                wake = m_caller_waiting;
+            }
+            if( wake )
+                m_ready_cv.notify_one();
+
+            // Every node pushed onto the ready queue is matched by
+            // one task which runs the next node. If the thread in
+            // wait() got to the node first, the task does nothing.
+            m_outstanding.fetch_add(1, std::memory_order_relaxed);
+            m_thread_pool->operator()(m_run_next);
         });
 
-        graph.setOnComplete(
-        [this]()
+        graph.setOnSpawn(
+        [this](std::function<void(void)> & help)
         {
-           m_cv.notify_all();
+            if( m_inline_frame )
+            {
+                if( std::this_thread::get_id() == m_inline_thread )
+                    return false;
+
+                // an asynchronous node resumed by another thread is handed
+                // back to the thread executing the frame. Notify under the
+                // lock so execute() cannot return before we are done.
+                std::lock_guard<std::mutex> L(m_ready_lock);
+                m_helpers.push(&help);
+                m_ready_cv.notify_one();
+                return true;
+            }
+
+            if( m_wait_policy == wait_policy::block )
+            {
+                m_thread_pool->operator()(help);
+                return true;
+            }
+
+            // go through the executor's queue so that the thread in
+            // wait() can help, and is woken if a helper finishes the frame
+            bool wake;
+            {
+                std::lock_guard<std::mutex> L(m_ready_lock);
+                m_helpers.push(&help);
+                wake = m_caller_waiting;
+            }
+            if( wake )
+                m_ready_cv.notify_one();
+
+            m_outstanding.fetch_add(1, std::memory_order_relaxed);
+            m_thread_pool->operator()(m_run_next);
+            return true;
         });
+
+        m_run_next = [this]()
+        {
+            if( run_next() )
+            {
+                if( m_wait_policy == wait_policy::participate && m_graph.is_idle() )
+                {
+                    // wake the thread in wait(). Taking the lock makes
+                    // sure it is either sleeping or has not yet checked
+                    // whether the graph is idle.
+                    { std::lock_guard<std::mutex> L(m_ready_lock); }
+                    m_ready_cv.notify_all();
+                }
+            }
+            m_outstanding.fetch_sub(1, std::memory_order_release);
+        };
     }
 
     void set_thread_pool(ThreadPool_t * T)
@@ -39,37 +142,220 @@ public:
     {
         return m_thread_pool;
     }
+
+    /**
+     * @brief set_policy
+     * @param p
+     *
+     * Sets the order in which ready nodes are dispatched. With
+     * schedule_policy::critical_path, ready nodes are held in a priority
+     * queue and the thread pool is handed tasks which run the node with the
+     * longest remaining path first. The graph should be compiled.
+     * Must not be changed while the graph is executing.
+     */
+    void set_policy(schedule_policy p)
+    {
+        m_policy = p;
+    }
+
+    schedule_policy get_policy() const
+    {
+        return m_policy;
+    }
+
+    /**
+     * @brief set_wait_policy
+     * @param p
+     *
+     * With wait_policy::participate, wait() runs ready nodes on the
+     * calling thread until the graph has finished, instead of sleeping.
+     * Must not be changed while the graph is executing.
+     */
+    void set_wait_policy(wait_policy p)
+    {
+        m_wait_policy = p;
+    }
+
+    wait_policy get_wait_policy() const
+    {
+        return m_wait_policy;
+    }
+
+    /**
+     * @brief set_inline_threshold
+     * @param num_nodes
+     *
+     * Graphs with at most num_nodes nodes are executed entirely on the
+     * thread calling execute(), without handing any work to the thread
+     * pool. Default is 0, ie: never.
+     */
+    void set_inline_threshold(std::size_t num_nodes)
+    {
+        m_inline_threshold = num_nodes;
+    }
+
+    std::size_t get_inline_threshold() const
+    {
+        return m_inline_threshold;
+    }
+
+    /**
+     * @brief set_inline_continuation
+     * @param enable
+     *
+     * When a node makes its dependents ready, keep the first one and run
+     * it on the same worker once the node returns, sending only the
+     * others to the thread pool. See node_graph::set_inline_continuation().
+     */
+    void set_inline_continuation(bool enable)
+    {
+        m_graph.set_inline_continuation(enable);
+    }
+
     ~threaded_executor()
     {
         wait();
+        // tasks which found the ready queue empty, or helpers of parallel
+        // nodes which found no chunks left, may still be in the pool
+        while( m_outstanding.load(std::memory_order_acquire) != 0 || m_graph.get_num_spawned() != 0 )
+            std::this_thread::yield();
     }
 
+    /**
+     * @brief wait
+     *
+     * Blocks until the frame started by execute() has finished.
+     */
     void wait()
     {
-        std::unique_lock<std::mutex> lk(m_wait_lock);
-        m_cv.wait(lk, [this] { return !m_graph.busy(); } );
+        if( m_wait_policy == wait_policy::participate )
+        {
+            std::unique_lock<std::mutex> lk(m_ready_lock);
+            for(;;)
+            {
+                if( !m_helpers.empty() || !m_ready.empty() || !m_fifo.empty() )
+                {
+                    lk.unlock();
+                    run_next();
+                    lk.lock();
+                    continue;
+                }
+                if( m_graph.is_idle() )
+                    break;
+
+                m_caller_waiting = true;
+                m_ready_cv.wait(lk);
+                m_caller_waiting = false;
+            }
+        }
+        m_graph.wait();
     }
 
     void execute()
     {
-        for(auto & N : m_graph.get_exec_nodes()) // place all the nodes with no resource requirements onto the queue.
+        if( m_graph.get_exec_nodes().size() <= m_inline_threshold )
         {
-            if( N->can_execute() )
+            m_inline_frame  = true;
+            m_inline_thread = std::this_thread::get_id();
+            m_graph.trigger_all();
+            for(;;) // same as serial_executor::execute()
             {
-                m_graph.schedule_node(N.get());
+                while( auto N = pop_ready() )
+                {
+                    N->run();
+                }
+                if( m_graph.is_idle() )
+                    break;
+
+                // wait for a suspended asynchronous node to be resumed
+                std::function<void(void)> * H;
+                {
+                    std::unique_lock<std::mutex> lk(m_ready_lock);
+                    m_ready_cv.wait(lk, [this] { return !m_helpers.empty(); } );
+                    H = m_helpers.pop();
+                }
+                (*H)();
             }
+            m_inline_frame = false;
+            return;
         }
+        m_graph.trigger_all(); // place all the nodes whose resources are available onto the queue.
     }
 
 
 private:
+    /**
+     * @brief run_next
+     * @return
+     *
+     * Runs the next helper of a parallel node, or the next ready node.
+     * Returns false if there was nothing to run.
+     */
+    bool run_next()
+    {
+        std::function<void(void)> * H = nullptr;
+        exec_node                 * N = nullptr;
+        {
+            std::lock_guard<std::mutex> L(m_ready_lock);
+            if( !m_helpers.empty() )
+            {
+                H = m_helpers.pop();
+            }
+            else
+            {
+                N = pop_ready();
+            }
+        }
+        if( H )
+            (*H)();
+        else if( N )
+            N->run();
+        return H || N;
+    }
+
+    void push_ready(exec_node * N)
+    {
+        if( m_policy == schedule_policy::critical_path )
+            m_ready.push(N);
+        else
+            m_fifo.push(N);
+    }
+
+    /**
+     * @brief pop_ready
+     * @return
+     *
+     * Removes the next node from the ready queue, or returns nullptr
+     * if it is empty.
+     */
+    exec_node * pop_ready()
+    {
+        if( !m_ready.empty() )
+            return m_ready.pop();
+        if( !m_fifo.empty() )
+            return m_fifo.pop();
+        return nullptr;
+    }
+
     node_graph                 & m_graph;
     ThreadPool_t               *m_thread_pool = nullptr;
-    std::mutex                  m_wait_lock;
-    std::condition_variable     m_cv;
+
+    schedule_policy             m_policy = schedule_policy::fifo;
+    wait_policy                 m_wait_policy = wait_policy::block;
+    std::size_t                 m_inline_threshold = 0;
+    bool                        m_inline_frame = false;
+    std::thread::id             m_inline_thread;   // the thread executing an inline frame
+
+    std::mutex                  m_ready_lock;
+    std::condition_variable     m_ready_cv;
+    bool                        m_caller_waiting = false;
+    ready_queue                 m_ready;
+    fifo_queue<exec_node*>      m_fifo;
+    fifo_queue<std::function<void(void)>*> m_helpers; // helpers of parallel nodes in participate mode, and resumed nodes in inline frames
+    std::atomic<uint32_t>       m_outstanding{0}; // tasks handed to the pool which have not returned
+    std::function<void(void)>   m_run_next;
 };
 
 }
 
 #endif
-
@@ -0,0 +1,399 @@
+#pragma once
+
+#ifndef TRACE_GRAPH_3_H
+#define TRACE_GRAPH_3_H
+
+#include "node_graph.h"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace graphe
+{
+
+/**
+ * @brief The trace_event struct
+ *
+ * A single event recorded by the trace_recorder. Spans have a begin and
+ * end time, instant events only use begin.
+ */
+struct trace_event
+{
+    enum class kind : uint8_t
+    {
+        span,    // a node execution
+        instant  // a resource becoming available
+    };
+
+    kind             type;
+    std::string_view name;   // points into the node/resource, which must outlive flush()
+    time_point       begin;
+    time_point       end;
+};
+
+/**
+ * @brief The trace_ring class
+ *
+ * A fixed size single-producer/single-consumer ring buffer of trace_events.
+ * The producer is the thread which owns the ring, the consumer is the
+ * thread calling trace_recorder::flush(). Events pushed while the ring is
+ * full are dropped and counted.
+ */
+class trace_ring
+{
+public:
+    explicit trace_ring(std::size_t capacity) : m_events(round_up(capacity)), m_mask(m_events.size()-1)
+    {
+    }
+
+    void push(trace_event const & e)
+    {
+        auto t = m_tail.load(std::memory_order_relaxed);
+        if( t - m_head.load(std::memory_order_acquire) == m_events.size() )
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_events[t & m_mask] = e;
+        m_tail.store(t+1, std::memory_order_release);
+    }
+
+    /**
+     * @brief drain
+     * @param f
+     *
+     * Calls f on every event in the ring and empties it.
+     */
+    template<typename F>
+    void drain(F && f)
+    {
+        auto h = m_head.load(std::memory_order_relaxed);
+        auto t = m_tail.load(std::memory_order_acquire);
+        for( ; h != t; ++h)
+        {
+            f( m_events[h & m_mask] );
+        }
+        m_head.store(h, std::memory_order_release);
+    }
+
+    std::size_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+    static std::size_t round_up(std::size_t n)
+    {
+        std::size_t c = 1;
+        while( c < n ) c <<= 1;
+        return c;
+    }
+
+    std::vector<trace_event>  m_events;
+    std::size_t               m_mask;
+    alignas(64) std::atomic<std::size_t> m_head{0};
+    alignas(64) std::atomic<std::size_t> m_tail{0};
+    std::atomic<std::size_t>  m_dropped{0};
+};
+
+/**
+ * @brief The trace_recorder class
+ *
+ * Records node executions and resource availability of a node_graph and
+ * writes them in the Chrome Trace Event JSON format, which can be opened
+ * in chrome://tracing or https://ui.perfetto.dev. Each thread which
+ * executes nodes gets its own track. Tracks are numbered in the order the
+ * threads first record, and the metadata of each track gives the
+ * std::thread::id of its thread.
+ *
+ * Events are buffered in a lock-free ring owned by the recording thread, so
+ * recording does not take any locks (except once per thread, the first time
+ * it records). Call flush() after the executor's wait() to move the events
+ * out of the rings, and write() once all the frames of interest have
+ * been flushed.
+ *
+ *   trace_recorder T(G);
+ *
+ *   Exec.execute();
+ *   Exec.wait();
+ *   T.flush();
+ *
+ *   T.write("trace.json");
+ */
+class trace_recorder
+{
+public:
+    explicit trace_recorder(node_graph & graph, std::size_t events_per_thread = 4096) :
+        m_graph(graph),
+        m_capacity(events_per_thread),
+        m_id( next_id() ),
+        m_origin( clock::now() )
+    {
+        {
+            std::lock_guard<std::mutex> L(live_lock());
+            live_ids().push_back(m_id);
+        }
+
+        graph.setOnExecuted(
+        [this](exec_node * N)
+        {
+            local_ring().push( {trace_event::kind::span, N->get_name(), N->get_time(), N->get_time() + N->get_duration()} );
+        });
+
+        graph.setOnResourceAvailable(
+        [this](resource_node * R)
+        {
+            local_ring().push( {trace_event::kind::instant, R->get_name(), R->get_time(), R->get_time()} );
+        });
+    }
+
+    ~trace_recorder()
+    {
+        m_graph.clearOnExecuted();
+        m_graph.clearOnResourceAvailable();
+
+        std::lock_guard<std::mutex> L(live_lock());
+        auto & live = live_ids();
+        live.erase( std::remove(live.begin(), live.end(), m_id), live.end() );
+    }
+
+    trace_recorder(trace_recorder const &) = delete;
+    trace_recorder & operator=(trace_recorder const &) = delete;
+
+    /**
+     * @brief flush
+     *
+     * Moves the events out of the per-thread rings. Must not be called
+     * while the graph is executing on more than one thread, ie: call it
+     * after the executor's wait().
+     */
+    void flush()
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        for(auto & T : m_threads)
+        {
+            T.ring->drain(
+            [&](trace_event const & e)
+            {
+                m_events.push_back( {e.type, T.tid, std::string(e.name), us(e.begin), us(e.end)} );
+            });
+        }
+    }
+
+    /**
+     * @brief clear
+     *
+     * Discards all flushed events.
+     */
+    void clear()
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        m_events.clear();
+    }
+
+    /**
+     * @brief dropped
+     * @return
+     *
+     * Returns the number of events which were dropped because a ring was
+     * full. Increase events_per_thread or flush more often.
+     */
+    std::size_t dropped() const
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        std::size_t d = 0;
+        for(auto & T : m_threads)
+            d += T.ring->dropped();
+        return d;
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+        return m_events.size();
+    }
+
+    /**
+     * @brief write
+     * @param out
+     *
+     * Writes all flushed events as a Chrome Trace Event JSON object.
+     */
+    void write(std::ostream & out) const
+    {
+        std::lock_guard<std::mutex> L(m_lock);
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        auto sep = [&]()
+        {
+            if( !first ) out << ",\n";
+            first = false;
+        };
+
+        for(auto & T : m_threads)
+        {
+            sep();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << T.tid
+                << ",\"args\":{\"name\":\"thread " << T.tid << "\",\"thread_id\":\"" << T.id << "\"}}";
+        }
+
+        out << std::fixed << std::setprecision(3);
+        for(auto & e : m_events)
+        {
+            sep();
+            out << "{\"name\":\"";
+            write_escaped(out, e.name);
+            if( e.type == trace_event::kind::span )
+            {
+                out << "\",\"cat\":\"node\",\"ph\":\"X\",\"ts\":" << e.begin << ",\"dur\":" << (e.end - e.begin);
+            }
+            else
+            {
+                out << "\",\"cat\":\"resource\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << e.begin;
+            }
+            out << ",\"pid\":1,\"tid\":" << e.tid << "}";
+        }
+        out << std::defaultfloat;
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    /**
+     * @brief write
+     * @param path
+     * @return
+     *
+     * Writes all flushed events to a file. Returns false if the file
+     * could not be opened.
+     */
+    bool write(std::string const & path) const
+    {
+        std::ofstream out(path);
+        if( !out )
+            return false;
+        write(out);
+        return static_cast<bool>(out);
+    }
+
+protected:
+    struct thread_track
+    {
+        uint32_t                    tid; // index of the track in the trace
+        std::thread::id             id;  // the thread which records into it
+        std::unique_ptr<trace_ring> ring;
+    };
+
+    struct ring_cache
+    {
+        uint64_t     owner;
+        trace_ring * ring;
+    };
+
+    struct flushed_event
+    {
+        trace_event::kind type;
+        uint32_t          tid;
+        std::string       name;
+        double            begin; // microseconds since the recorder was created
+        double            end;
+    };
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> id{1};
+        return id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief live_ids
+     * @return
+     *
+     * The ids of the recorders which have not been destroyed. Ids are never
+     * reused, so a cached ring whose owner is not in this list is stale.
+     */
+    static std::vector<uint64_t> & live_ids()
+    {
+        static std::vector<uint64_t> ids;
+        return ids;
+    }
+
+    static std::mutex & live_lock()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::vector<ring_cache> & thread_cache()
+    {
+        thread_local std::vector<ring_cache> C; // a thread may record into several recorders
+        return C;
+    }
+
+    double us(time_point t) const
+    {
+        return std::chrono::duration<double, std::micro>(t - m_origin).count();
+    }
+
+    /**
+     * @brief local_ring
+     * @return
+     *
+     * Returns the ring owned by the calling thread, creating it the first
+     * time this thread records into this recorder. The entries of the
+     * recorders destroyed since are pruned at the same time, so a thread's
+     * cache does not grow with every recorder it has ever recorded into.
+     */
+    trace_ring & local_ring()
+    {
+        auto & C = thread_cache();
+        for(auto & c : C)
+        {
+            if( c.owner == m_id )
+                return *c.ring;
+        }
+
+        {
+            std::lock_guard<std::mutex> L(live_lock());
+            auto & live = live_ids();
+            C.erase( std::remove_if(C.begin(), C.end(), [&](ring_cache const & c)
+                     {
+                         return std::find(live.begin(), live.end(), c.owner) == live.end();
+                     }), C.end() );
+        }
+
+        std::lock_guard<std::mutex> L(m_lock);
+        m_threads.push_back( {static_cast<uint32_t>(m_threads.size()), std::this_thread::get_id(), std::make_unique<trace_ring>(m_capacity)} );
+        C.push_back( {m_id, m_threads.back().ring.get()} );
+        return *C.back().ring;
+    }
+
+    static void write_escaped(std::ostream & out, std::string const & s)
+    {
+        for(auto c : s)
+        {
+            if( c == '"' || c == '\\' )
+                out << '\\' << c;
+            else if( static_cast<unsigned char>(c) < 0x20 )
+                out << ' ';
+            else
+                out << c;
+        }
+    }
+
+    node_graph                  & m_graph;
+    std::size_t                   m_capacity;
+    uint64_t                      m_id;
+    time_point                    m_origin;
+
+    mutable std::mutex            m_lock;
+    std::vector<thread_track>     m_threads;
+    std::vector<flushed_event>    m_events;
+};
+
+}
+
+#endif
@@ -0,0 +1,366 @@
+/**
+ * graphe_bench
+ *
+ * Measures the scheduling overhead of the executors on synthetic graphs:
+ *
+ *   chain    - each node requires the output of the previous one
+ *   fan      - one source, a wide layer of independent nodes, one sink
+ *   random   - each node requires the outputs of up to 3 random earlier nodes
+ *   lattice  - a square grid, each node requires its left and upper neighbours
+ *
+ * Node bodies are empty, or spin for --work-ns nanoseconds. Every graph is
+ * executed by the serial_executor and by the threaded_executor on
+ * gnl::thread_pool and gnl::work_stealing_pool, with 1 to --threads workers.
+ *
+ * The results are written as JSON to stdout, or to the file given by --out.
+ *
+ * With --spin, the workers of gnl::thread_pool use
+ * gnl::idle_policy::spin_then_park() instead of parking immediately.
+ *
+ *   graphe_bench [--nodes N] [--frames N] [--threads N] [--work-ns N] [--seed N] [--spin] [--out file]
+ */
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#define GRAPHE_TRACK_ALLOCATIONS // count every allocation made by the process
+#include "graph-e/alloc_tracker.h"
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "graph-e/threaded_executor.h"
+#include "gnl/gnl_threadpool.h"
+#include "gnl/gnl_work_stealing_pool.h"
+
+//=============================================================================
+// The node used by every graph
+//=============================================================================
+static std::chrono::nanoseconds g_work{0};
+
+class bench_node
+{
+public:
+    std::vector< graphe::in_resource<int> > inputs;
+    graphe::out_resource<int>               output;
+
+    bench_node( graphe::ResourceRegistry & G, std::vector<std::string> const & in, std::string const & out)
+    {
+        for(auto & n : in)
+            inputs.push_back( G.register_input_resource<int>(n) );
+        output = G.register_output_resource<int>(out);
+    }
+
+    void operator()()
+    {
+        int sum = 1;
+        for(auto & i : inputs)
+            sum += i.get();
+
+        if( g_work.count() )
+        {
+            auto end = graphe::clock::now() + g_work;
+            while( graphe::clock::now() < end )
+            {
+            }
+        }
+        output.set(sum);
+    }
+};
+
+static std::string rname(std::size_t i)
+{
+    return "r" + std::to_string(i);
+}
+
+static void make_chain(graphe::node_graph & G, std::size_t n, uint32_t)
+{
+    G.add_node<bench_node>( std::vector<std::string>{}, rname(0) );
+    for(std::size_t i=1; i < n; ++i)
+        G.add_node<bench_node>( std::vector<std::string>{ rname(i-1) }, rname(i) );
+}
+
+static void make_fan(graphe::node_graph & G, std::size_t n, uint32_t)
+{
+    n = std::max<std::size_t>(n, 3);
+    G.add_node<bench_node>( std::vector<std::string>{}, rname(0) );
+    std::vector<std::string> layer;
+    for(std::size_t i=1; i+1 < n; ++i)
+    {
+        G.add_node<bench_node>( std::vector<std::string>{ rname(0) }, rname(i) );
+        layer.push_back( rname(i) );
+    }
+    G.add_node<bench_node>( layer, rname(n-1) );
+}
+
+static void make_random(graphe::node_graph & G, std::size_t n, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    for(std::size_t i=0; i < n; ++i)
+    {
+        std::vector<std::string> in;
+        if( i > 0 )
+        {
+            std::uniform_int_distribution<std::size_t> pick(0, i-1);
+            auto k = std::min<std::size_t>(i, 3);
+            std::vector<std::size_t> chosen;
+            while( chosen.size() < k )
+            {
+                auto j = pick(rng);
+                if( std::find(chosen.begin(), chosen.end(), j) == chosen.end() )
+                    chosen.push_back(j);
+            }
+            for(auto j : chosen)
+                in.push_back( rname(j) );
+        }
+        G.add_node<bench_node>( in, rname(i) );
+    }
+}
+
+static void make_lattice(graphe::node_graph & G, std::size_t n, uint32_t)
+{
+    auto side = std::max<std::size_t>(1, static_cast<std::size_t>( std::sqrt( static_cast<double>(n) ) ) );
+    for(std::size_t y=0; y < side; ++y)
+    {
+        for(std::size_t x=0; x < side; ++x)
+        {
+            std::vector<std::string> in;
+            if( x > 0 ) in.push_back( rname(y*side + x-1) );
+            if( y > 0 ) in.push_back( rname((y-1)*side + x) );
+            G.add_node<bench_node>( in, rname(y*side + x) );
+        }
+    }
+}
+
+//=============================================================================
+// Thread pool wrappers, see example_2_threadpool and example_4_work_stealing
+//=============================================================================
+struct ThreadPoolWrapper
+{
+    gnl::thread_pool * m_threadpool;
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->post( [&exec]{ exec(); } );
+    }
+};
+
+struct WorkStealingWrapper
+{
+    gnl::work_stealing_pool * m_threadpool;
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->push_ref(exec);
+    }
+};
+
+//=============================================================================
+// Measurement
+//=============================================================================
+struct options
+{
+    std::size_t nodes   = 1000;
+    std::size_t frames  = 200;
+    std::size_t warmup  = 10;
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t    seed    = 1;
+    bool        spin    = false; // idle workers of gnl::thread_pool spin before parking
+    std::string out;
+};
+
+struct result
+{
+    std::string graph;
+    std::string executor;
+    std::string pool;
+    std::size_t threads = 0;
+    std::size_t nodes   = 0;
+    std::vector<double> frame_ns;
+    uint64_t    allocations = 0;
+};
+
+/**
+ * Runs warmup + frames frames. frame() must execute the graph and wait
+ * until it has finished. The graph is reset after each frame, which is
+ * counted in the frame time.
+ */
+template<typename F>
+static void measure(options const & o, graphe::node_graph & G, result & r, F && frame)
+{
+    for(std::size_t i=0; i < o.warmup; ++i)
+    {
+        frame();
+        G.reset();
+    }
+
+    r.frame_ns.reserve(o.frames);
+    graphe::allocation_tracker::begin();
+    for(std::size_t i=0; i < o.frames; ++i)
+    {
+        auto t0 = graphe::clock::now();
+        frame();
+        G.reset();
+        auto t1 = graphe::clock::now();
+        r.frame_ns.push_back( static_cast<double>( std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count() ) );
+    }
+    r.allocations = graphe::allocation_tracker::end();
+}
+
+static double percentile(std::vector<double> v, double p)
+{
+    if( v.empty() ) return 0;
+    std::sort(v.begin(), v.end());
+    return v[ static_cast<std::size_t>( p * static_cast<double>(v.size()-1) + 0.5 ) ];
+}
+
+static void write_json(std::ostream & out, options const & o, std::vector<result> const & results)
+{
+    out << std::fixed << std::setprecision(1);
+    out << "{\n";
+    out << "  \"benchmark\": \"graphe_bench\",\n";
+    out << "  \"nodes\": "   << o.nodes  << ",\n";
+    out << "  \"frames\": "  << o.frames << ",\n";
+    out << "  \"work_ns\": " << g_work.count() << ",\n";
+    out << "  \"seed\": "    << o.seed   << ",\n";
+    out << "  \"idle_policy\": \"" << (o.spin ? "spin_then_park" : "park") << "\",\n";
+    out << "  \"results\": [\n";
+    for(std::size_t i=0; i < results.size(); ++i)
+    {
+        auto & r = results[i];
+        double mean = 0;
+        for(auto x : r.frame_ns) mean += x;
+        mean /= static_cast<double>( std::max<std::size_t>(1, r.frame_ns.size()) );
+
+        auto n        = static_cast<double>(r.nodes);
+        auto overhead = (mean - n * static_cast<double>(g_work.count())) / n; // wall clock per node which is not spent in the body
+
+        out << "    {"
+            << "\"graph\": \""    << r.graph    << "\", "
+            << "\"executor\": \"" << r.executor << "\", "
+            << "\"pool\": \""     << r.pool     << "\", "
+            << "\"threads\": "    << r.threads  << ", "
+            << "\"nodes\": "      << r.nodes    << ", "
+            << "\"nodes_per_sec\": "        << n * 1e9 / mean << ", "
+            << "\"dispatch_overhead_ns\": " << overhead << ", "
+            << "\"frame_ns\": {"
+                << "\"mean\": " << mean << ", "
+                << "\"p50\": "  << percentile(r.frame_ns, 0.50) << ", "
+                << "\"p90\": "  << percentile(r.frame_ns, 0.90) << ", "
+                << "\"p99\": "  << percentile(r.frame_ns, 0.99) << ", "
+                << "\"max\": "  << percentile(r.frame_ns, 1.00) << "}, "
+            << "\"allocations_per_frame\": " << static_cast<double>(r.allocations) / static_cast<double>(r.frame_ns.size())
+            << "}" << (i+1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+static options parse(int argc, char ** argv)
+{
+    options o;
+    for(int i=1; i < argc; ++i)
+    {
+        auto arg   = std::string(argv[i]);
+        auto value = [&]() -> std::string
+        {
+            if( i+1 >= argc )
+            {
+                std::cerr << arg << " requires a value" << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if(      arg == "--nodes"   ) o.nodes   = std::stoul( value() );
+        else if( arg == "--frames"  ) o.frames  = std::stoul( value() );
+        else if( arg == "--threads" ) o.threads = std::max<std::size_t>(1, std::stoul( value() ) );
+        else if( arg == "--work-ns" ) g_work    = std::chrono::nanoseconds( std::stol( value() ) );
+        else if( arg == "--seed"    ) o.seed    = static_cast<uint32_t>( std::stoul( value() ) );
+        else if( arg == "--out"     ) o.out     = value();
+        else if( arg == "--spin"    ) o.spin    = true;
+        else
+        {
+            std::cerr << "usage: graphe_bench [--nodes N] [--frames N] [--threads N] [--work-ns N] [--seed N] [--spin] [--out file]" << std::endl;
+            std::exit(1);
+        }
+    }
+    return o;
+}
+
+int main(int argc, char ** argv)
+{
+    auto o = parse(argc, argv);
+
+    using generator = void(*)(graphe::node_graph &, std::size_t, uint32_t);
+    std::vector< std::pair<char const*, generator> > graphs = {
+        {"chain",   make_chain},
+        {"fan",     make_fan},
+        {"random",  make_random},
+        {"lattice", make_lattice}
+    };
+
+    std::vector<std::size_t> thread_counts;
+    for(std::size_t t=1; t < o.threads; t *= 2)
+        thread_counts.push_back(t);
+    thread_counts.push_back(o.threads);
+
+    std::vector<result> results;
+    for(auto & g : graphs)
+    {
+        auto run = [&](char const * executor, char const * pool, std::size_t threads, auto && body)
+        {
+            std::cerr << g.first << " " << executor << " " << pool << " " << threads << std::endl;
+
+            graphe::node_graph G;
+            g.second(G, o.nodes, o.seed);
+            G.compile();
+
+            result r;
+            r.graph    = g.first;
+            r.executor = executor;
+            r.pool     = pool;
+            r.threads  = threads;
+            r.nodes    = G.get_plan().nodes.size();
+            body(G, r);
+            results.push_back( std::move(r) );
+        };
+
+        run("serial_executor", "none", 1, [&](graphe::node_graph & G, result & r)
+        {
+            graphe::serial_executor Exec(G);
+            measure(o, G, r, [&]{ Exec.execute(); });
+        });
+
+        for(auto t : thread_counts)
+        {
+            run("threaded_executor", "thread_pool", t, [&](graphe::node_graph & G, result & r)
+            {
+                gnl::thread_pool T(t);
+                if( o.spin )
+                    T.set_idle_policy( gnl::idle_policy::spin_then_park() );
+                ThreadPoolWrapper TW{&T};
+                graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+                Exec.set_thread_pool(&TW);
+                measure(o, G, r, [&]{ Exec.execute(); Exec.wait(); });
+            });
+
+            run("threaded_executor", "work_stealing_pool", t, [&](graphe::node_graph & G, result & r)
+            {
+                gnl::work_stealing_pool T(t);
+                WorkStealingWrapper TW{&T};
+                graphe::threaded_executor<WorkStealingWrapper> Exec(G);
+                Exec.set_thread_pool(&TW);
+                measure(o, G, r, [&]{ Exec.execute(); Exec.wait(); });
+            });
+        }
+    }
+
+    if( o.out.empty() )
+    {
+        write_json(std::cout, o, results);
+    }
+    else
+    {
+        std::ofstream f(o.out);
+        write_json(f, o, results);
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef GRAPHE_TESTS_CHECK_H
+#define GRAPHE_TESTS_CHECK_H
+
+#include "gnl/gnl_threadpool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+// Minimal assertion used by the tests: reports the failed expression and
+// exits with a non-zero status so ctest marks the test as failed.
+#define CHECK(expr) \
+    do { \
+        if( !(expr) ) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            std::exit(1); \
+        } \
+    } while(0)
+
+/**
+ * @brief The ThreadPoolWrapper struct
+ *
+ * Hands the executors' functors to a gnl::thread_pool, as in the examples.
+ */
+struct ThreadPoolWrapper
+{
+    ThreadPoolWrapper( gnl::thread_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_threadpool->post(exec);
+    }
+    gnl::thread_pool * m_threadpool;
+};
+
+#endif
@@ -0,0 +1,115 @@
+// A graph built in an arena executes like any other, including in
+// incremental mode on a thread pool, where every node records the
+// revisions of its inputs from a worker thread. The arena is not thread
+// safe, so that storage must not be allocated during a frame. Node and
+// resource names are still returned as std::string references.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    int * value;
+    Source( graphe::ResourceRegistry & G, int * v) : value(v)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set_if_changed(*value);
+    }
+};
+
+struct Stage
+{
+    std::vector< graphe::in_resource<int> > in;
+    graphe::out_resource<int>               out;
+    std::atomic<int> * runs;
+    Stage( graphe::ResourceRegistry & G, int i, std::atomic<int> * r) : runs(r)
+    {
+        in.push_back( G.register_input_resource<int>("x") );
+        for(int j=0; j < i; ++j)
+            in.push_back( G.register_input_resource<int>( "s_" + std::to_string(j) ) );
+        out = G.register_output_resource<int>( "s_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        ++*runs;
+        int s = 0;
+        for(auto & r : in)
+            s += r.get();
+        out.set(s);
+    }
+};
+
+struct Sink
+{
+    graphe::in_resource<int> last;
+    int * result;
+    Sink( graphe::ResourceRegistry & G, int n, int * r) : result(r)
+    {
+        last = G.register_input_resource<int>( "s_" + std::to_string(n-1) );
+    }
+    void operator()()
+    {
+        *result = last.get();
+    }
+};
+
+int main()
+{
+    const int stages = 12;
+    int value  = 1;
+    int result = 0;
+    std::atomic<int> runs{0};
+
+    graphe::node_graph G(256); // small, so the arena grows while the graph is built
+    G.set_incremental(true);
+    G.add_node<Source>(&value);
+    for(int i=0; i < stages; ++i)
+        G.add_node<Stage>(i, &runs);
+    auto & sink = G.add_node<Sink>(stages, &result);
+    sink.set_name("sink");
+    G.compile();
+
+    // names are returned by reference, as std::strings
+    std::string const & name = sink.get_name();
+    CHECK( std::string( name.c_str() ) == "sink" );
+    CHECK( sink.name_view() == "sink" );
+    std::string const & rname = G.get_resources("x")->get_name();
+    CHECK( rname == "x" );
+
+    gnl::thread_pool T(4);
+    ThreadPoolWrapper W(T);
+    graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+    Exec.set_thread_pool(&W);
+
+    for(int frame=0; frame < 50; ++frame)
+    {
+        if( frame % 10 == 0 )
+            value = frame + 1;
+        runs = 0;
+        Exec.execute();
+        Exec.wait();
+
+        if( frame % 10 == 0 )
+        {
+            CHECK( runs == stages );
+            CHECK( G.get_num_skipped() == 0 );
+        }
+        else
+        {
+            CHECK( runs == 0 );
+            CHECK( G.get_num_skipped() == stages + 1 );
+        }
+        CHECK( result == value << (stages-1) ); // s_i = x * 2^i
+        G.reset();
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Asynchronous nodes resumed by the timer thread must be continued by the
+// thread executing the frame when there is no thread pool: the
+// serial_executor, and the threaded_executor below its inline threshold.
+// Requires C++20.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/coro_node.h"
+#include "graph-e/serial_executor.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <string>
+#include <thread>
+
+struct Sleep
+{
+    graphe::out_resource<int> value;
+    int i;
+    std::thread::id * thread;
+    Sleep( graphe::ResourceRegistry & G, int _i, std::thread::id * t) : i(_i), thread(t)
+    {
+        value = G.register_output_resource<int>( "value_" + std::to_string(i) );
+    }
+    graphe::node_task operator()()
+    {
+        co_await graphe::sleep_for( std::chrono::milliseconds(5) );
+        *thread = std::this_thread::get_id();
+        value.set(i);
+    }
+};
+
+struct Sum
+{
+    graphe::in_resource<int> a;
+    graphe::in_resource<int> b;
+    int * result;
+    Sum( graphe::ResourceRegistry & G, int * r) : result(r)
+    {
+        a = G.register_input_resource<int>("value_1");
+        b = G.register_input_resource<int>("value_2");
+    }
+    void operator()()
+    {
+        *result = a.get() + b.get();
+    }
+};
+
+template<typename Executor_t>
+static void run_frames(graphe::node_graph & G, Executor_t & Exec, int & result, std::thread::id (&resumed)[2])
+{
+    for(int frame=0; frame < 3; ++frame)
+    {
+        result = 0;
+        Exec.execute();
+
+        // the frame has finished when execute() returns, and both
+        // nodes were continued on this thread
+        CHECK( G.is_idle() );
+        CHECK( result == 3 );
+        CHECK( resumed[0] == std::this_thread::get_id() );
+        CHECK( resumed[1] == std::this_thread::get_id() );
+        G.reset();
+    }
+}
+
+int main()
+{
+    {
+        int result = 0;
+        std::thread::id resumed[2];
+
+        graphe::node_graph G;
+        G.add_async_node<Sleep>(1, &resumed[0]);
+        G.add_async_node<Sleep>(2, &resumed[1]);
+        G.add_node<Sum>(&result);
+        G.compile();
+
+        graphe::serial_executor Exec(G);
+        run_frames(G, Exec, result, resumed);
+    }
+
+    {
+        int result = 0;
+        std::thread::id resumed[2];
+
+        graphe::node_graph G;
+        G.add_async_node<Sleep>(1, &resumed[0]);
+        G.add_async_node<Sleep>(2, &resumed[1]);
+        G.add_node<Sum>(&result);
+        G.compile();
+
+        gnl::thread_pool T(2);
+        ThreadPoolWrapper W(T);
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        Exec.set_inline_threshold(8);
+        run_frames(G, Exec, result, resumed);
+    }
+    return 0;
+}
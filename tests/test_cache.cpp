@@ -0,0 +1,156 @@
+// Memoized nodes: container and user-hashed inputs can be cached, and the
+// outputs are stored even if a dependent destroys them (as a transient
+// resource) before the producing node returns.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Mesh
+{
+    std::vector<float> vertices;
+    int                id = 0;
+};
+
+template<>
+struct graphe::resource_hash<Mesh>
+{
+    std::size_t operator()(Mesh const & m) const
+    {
+        return static_cast<std::size_t>(m.id);
+    }
+};
+
+struct Source
+{
+    graphe::out_resource< std::vector<float> > lut;
+    graphe::out_resource< Mesh >               mesh;
+    Source( graphe::ResourceRegistry & G)
+    {
+        lut  = G.register_output_resource< std::vector<float> >("lut");
+        mesh = G.register_output_resource< Mesh >("mesh");
+    }
+    void operator()()
+    {
+        lut.set( std::vector<float>{1.0f, 2.0f, 3.0f} );
+        mesh.set( Mesh{ {0.5f}, 7 } );
+    }
+};
+
+/**
+ * Publishes its output and, when handshake is set, does not return until
+ * the consumer has read it, so the transient output is destroyed before
+ * the node finishes.
+ */
+struct Memoized
+{
+    graphe::in_resource< std::vector<float> > lut;
+    graphe::in_resource< Mesh >               mesh;
+    graphe::out_resource< std::vector<float> > out;
+    int               * calls;
+    std::atomic<bool> * consumed;
+    bool                handshake;
+    Memoized( graphe::ResourceRegistry & G, int * c, std::atomic<bool> * d, bool h) : calls(c), consumed(d), handshake(h)
+    {
+        lut  = G.register_input_resource< std::vector<float> >("lut");
+        mesh = G.register_input_resource< Mesh >("mesh");
+        out  = G.register_output_resource< std::vector<float> >("out");
+    }
+    void operator()()
+    {
+        ++*calls;
+        std::vector<float> v;
+        for(auto x : lut.get())
+            v.push_back( x * mesh.get().vertices[0] );
+        out.set( std::move(v) );
+        while( handshake && !consumed->load() )
+            std::this_thread::yield();
+    }
+};
+
+struct Sink
+{
+    graphe::in_resource< std::vector<float> > out;
+    float             * sum;
+    std::atomic<bool> * consumed;
+    Sink( graphe::ResourceRegistry & G, float * s, std::atomic<bool> * d) : sum(s), consumed(d)
+    {
+        out = G.register_input_resource< std::vector<float> >("out");
+    }
+    void operator()()
+    {
+        *sum = 0;
+        for(auto x : out.get())
+            *sum += x;
+        *consumed = true;
+    }
+};
+
+template<typename Executor_t>
+static void run(graphe::node_graph & G, Executor_t & Exec, graphe::exec_node & M,
+                int & calls, float & sum, std::atomic<bool> & consumed)
+{
+    for(int frame=0; frame < 3; ++frame)
+    {
+        consumed = false;
+        sum      = 0;
+        Exec.execute();
+        if constexpr( !std::is_same<Executor_t, graphe::serial_executor>::value )
+            Exec.wait();
+        CHECK( sum == 3.0f );
+        G.reset();
+    }
+    CHECK( calls == 1 );
+    CHECK( M.get_cache_stats().misses == 1 );
+    CHECK( M.get_cache_stats().hits   == 2 );
+    CHECK( M.get_cache_stats().entries == 1 );
+}
+
+int main()
+{
+    // container and user hashed inputs
+    {
+        int               calls = 0;
+        float             sum   = 0;
+        std::atomic<bool> consumed{false};
+
+        graphe::node_graph G;
+        G.add_node<Source>();
+        auto & M = G.add_node<Memoized>(&calls, &consumed, false);
+        G.add_node<Sink>(&sum, &consumed);
+        M.enable_cache(1024*1024);
+        G.compile();
+
+        graphe::serial_executor Exec(G);
+        run(G, Exec, M, calls, sum, consumed);
+    }
+
+    // the transient output is destroyed by the sink before the memoized
+    // node returns
+    {
+        int               calls = 0;
+        float             sum   = 0;
+        std::atomic<bool> consumed{false};
+
+        graphe::node_graph G;
+        G.set_transient_aliasing(true);
+        G.add_node<Source>();
+        auto & M = G.add_node<Memoized>(&calls, &consumed, true);
+        G.add_node<Sink>(&sum, &consumed);
+        M.enable_cache(1024*1024);
+        G.compile();
+        CHECK( G.get_resources("out")->is_transient() );
+
+        gnl::thread_pool T(2);
+        ThreadPoolWrapper W(T);
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        run(G, Exec, M, calls, sum, consumed);
+    }
+    return 0;
+}
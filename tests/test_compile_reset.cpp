@@ -0,0 +1,136 @@
+// Recompiling the plan after reset() removes a one-shot node must keep the
+// nodes in topological order, even though the resource the one-shot wrote
+// no longer has a producer.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "check.h"
+
+#include <vector>
+
+struct Load
+{
+    graphe::out_resource<int> in;
+    Load( graphe::ResourceRegistry & G)
+    {
+        in = G.register_output_resource<int, graphe::resource_flags::permanent>("in");
+    }
+    void operator()()
+    {
+        in.emplace(1);
+        in.make_available();
+    }
+};
+
+struct A
+{
+    graphe::in_resource<int>  in;
+    graphe::out_resource<int> x;
+    A( graphe::ResourceRegistry & G)
+    {
+        in = G.register_input_resource<int, graphe::resource_flags::permanent>("in");
+        x  = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.emplace( in.get() + 1 );
+        x.make_available();
+    }
+};
+
+struct B
+{
+    graphe::in_resource<int>  x;
+    graphe::out_resource<int> y;
+    B( graphe::ResourceRegistry & G)
+    {
+        x = G.register_input_resource<int>("x");
+        y = G.register_output_resource<int>("y");
+    }
+    void operator()()
+    {
+        y.emplace( x.get() + 1 );
+        y.make_available();
+    }
+};
+
+struct C
+{
+    graphe::in_resource<int>  y;
+    graphe::out_resource<int> z;
+    C( graphe::ResourceRegistry & G)
+    {
+        y = G.register_input_resource<int>("y");
+        z = G.register_output_resource<int>("z");
+    }
+    void operator()()
+    {
+        z.emplace( y.get() + 1 );
+        z.make_available();
+    }
+};
+
+struct D
+{
+    graphe::in_resource<int> z;
+    int * result;
+    D( graphe::ResourceRegistry & G, int * r) : result(r)
+    {
+        z = G.register_input_resource<int>("z");
+    }
+    void operator()()
+    {
+        *result = z.get();
+    }
+};
+
+static void check_chain(graphe::node_graph & G, std::vector<graphe::exec_node*> const & chain)
+{
+    auto & P = G.get_plan();
+    CHECK( P.nodes.size() >= chain.size() );
+
+    // the chain keeps its order at the end of the plan and its
+    // priorities decrease along it
+    auto first = P.nodes.size() - chain.size();
+    for(std::size_t i=0; i < chain.size(); ++i)
+    {
+        CHECK( P.nodes[first + i] == chain[i] );
+        CHECK( chain[i]->get_priority() == chain.size() - i );
+    }
+
+    CHECK( G.get_resources("x")->is_transient() );
+    CHECK( G.get_resources("y")->is_transient() );
+    CHECK( P.transient_pool_bytes < P.transient_bytes );
+}
+
+int main()
+{
+    int result = 0;
+
+    // nodes are added in reverse so that the plan's order comes from the sort
+    graphe::node_graph G;
+    G.set_transient_aliasing(true);
+    auto & d = G.add_node<D>(&result);
+    auto & c = G.add_node<C>();
+    auto & b = G.add_node<B>();
+    auto & a = G.add_node<A>();
+    G.add_oneshot_node<Load>();
+    std::vector<graphe::exec_node*> chain = { &a, &b, &c, &d };
+    G.compile();
+    check_chain(G, chain);
+
+    graphe::serial_executor Exec(G);
+    Exec.execute();
+    CHECK( result == 4 );
+
+    G.reset(); // removes the one-shot and recompiles
+    CHECK( G.get_plan().nodes.size() == chain.size() );
+    check_chain(G, chain);
+
+    result = 0;
+    Exec.execute();
+    CHECK( result == 4 );
+    G.reset();
+
+    return 0;
+}
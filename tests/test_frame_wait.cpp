@@ -0,0 +1,118 @@
+// node_graph::wait() returns once the frame has finished, with both
+// wait policies of the threaded_executor, and the graph may be destroyed
+// as soon as it has returned. Built twice: as C++17, where wait() sleeps
+// on a condition variable, and as C++20, where it uses std::atomic::wait.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#if defined(GRAPHE_EXPECT_ATOMIC_WAIT) && !defined(__cpp_lib_atomic_wait)
+    #error "std::atomic::wait is not available, node_graph::wait() would use the condition variable"
+#endif
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set(1);
+    }
+};
+
+struct Branch
+{
+    graphe::in_resource<int>  x;
+    graphe::out_resource<int> y;
+    Branch( graphe::ResourceRegistry & G, int i)
+    {
+        x = G.register_input_resource<int>("x");
+        y = G.register_output_resource<int>( "y_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        y.set( x.get() + 1 );
+    }
+};
+
+struct Join
+{
+    std::vector< graphe::in_resource<int> > y;
+    std::atomic<int> * sum;
+    Join( graphe::ResourceRegistry & G, int n, std::atomic<int> * s) : sum(s)
+    {
+        for(int i=0; i < n; ++i)
+            y.push_back( G.register_input_resource<int>( "y_" + std::to_string(i) ) );
+    }
+    void operator()()
+    {
+        int s = 0;
+        for(auto & r : y)
+            s += r.get();
+        *sum = s;
+    }
+};
+
+int main()
+{
+    const int branches = 16;
+    gnl::thread_pool T(4);
+    ThreadPoolWrapper W(T);
+
+    for(auto policy : { graphe::wait_policy::block, graphe::wait_policy::participate })
+    {
+        std::atomic<int> sum{0};
+
+        graphe::node_graph G;
+        G.add_node<Source>();
+        for(int i=0; i < branches; ++i)
+            G.add_node<Branch>(i);
+        G.add_node<Join>(branches, &sum);
+        G.compile();
+
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        Exec.set_wait_policy(policy);
+
+        for(int frame=0; frame < 200; ++frame)
+        {
+            sum = 0;
+            Exec.execute();
+            Exec.wait();
+            CHECK( G.is_idle() );
+            CHECK( sum == 2 * branches );
+            G.reset();
+        }
+    }
+
+    // the thread finishing the frame must be done with the graph by the
+    // time wait() returns, here it is destroyed straight away
+    for(int frame=0; frame < 200; ++frame)
+    {
+        std::atomic<int> sum{0};
+        auto G = std::make_unique<graphe::node_graph>();
+        G->add_node<Source>();
+        for(int i=0; i < branches; ++i)
+            G->add_node<Branch>(i);
+        G->add_node<Join>(branches, &sum);
+        G->compile();
+
+        {
+            graphe::threaded_executor<ThreadPoolWrapper> Exec(*G);
+            Exec.set_thread_pool(&W);
+            Exec.execute();
+            Exec.wait();
+        }
+        CHECK( sum == 2 * branches );
+        G.reset();
+    }
+    return 0;
+}
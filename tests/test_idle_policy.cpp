@@ -0,0 +1,107 @@
+// Idle workers spin and yield for a while, as set by the idle_policy, and
+// then park. Tasks are picked up whether the workers are spinning or
+// parked, and a pool whose workers are spinning shuts down promptly.
+
+#include "gnl/gnl_threadpool.h"
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+template<typename F>
+static bool wait_for(F && done)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while( !done() )
+    {
+        if( std::chrono::steady_clock::now() > deadline )
+            return false;
+        std::this_thread::sleep_for( std::chrono::microseconds(100) );
+    }
+    return true;
+}
+
+// the state of a chain is owned by its tasks, so that the last one may
+// still be returning when run_chain() does
+struct chain
+{
+    gnl::thread_pool * pool;
+    int                length;
+    std::atomic<int>   done{0};
+};
+
+static void step(std::shared_ptr<chain> c)
+{
+    if( ++c->done < c->length )
+        c->pool->post( [c]{ step(c); } );
+}
+
+// every task posts the next one, so the pool is idle between tasks for
+// as long as a post takes
+static bool run_chain(gnl::thread_pool & T, int length)
+{
+    auto c = std::make_shared<chain>();
+    c->pool   = &T;
+    c->length = length;
+    T.post( [c]{ step(c); } );
+    return wait_for( [&]{ return c->done.load() == length; } );
+}
+
+int main()
+{
+    const std::size_t workers = 3;
+
+    // parks immediately by default
+    {
+        gnl::thread_pool T(workers);
+        auto p = T.get_idle_policy();
+        CHECK( p.spin == 0 && p.yields == 0 && !p.adaptive );
+        CHECK( wait_for( [&]{ return T.num_parked() == workers; } ) );
+
+        // a parked worker is woken by post()
+        CHECK( run_chain(T, 100) );
+    }
+
+    // spin, then park
+    {
+        gnl::thread_pool T(workers);
+        T.set_idle_policy( gnl::idle_policy::spin_then_park() );
+        auto p = T.get_idle_policy();
+        CHECK( p.spin == gnl::idle_policy::spin_then_park().spin );
+        CHECK( p.yields == gnl::idle_policy::spin_then_park().yields );
+        CHECK( p.adaptive );
+
+        for(int burst=0; burst < 10; ++burst)
+        {
+            CHECK( run_chain(T, 1000) );
+            // once the burst is over, every worker parks again
+            CHECK( wait_for( [&]{ return T.num_parked() == workers; } ) );
+        }
+    }
+
+    // a fixed budget, changed while the pool is running
+    {
+        gnl::thread_pool T(workers);
+        T.set_idle_policy( {2000, 4, false} );
+        CHECK( run_chain(T, 1000) );
+        CHECK( wait_for( [&]{ return T.num_parked() == workers; } ) );
+
+        T.set_idle_policy( {} );
+        CHECK( run_chain(T, 100) );
+        CHECK( wait_for( [&]{ return T.num_parked() == workers; } ) );
+    }
+
+    // destroyed while its workers are spinning
+    {
+        auto start = std::chrono::steady_clock::now();
+        {
+            gnl::thread_pool T(workers);
+            T.set_idle_policy( gnl::idle_policy::spin_then_park() );
+            CHECK( run_chain(T, 100) );
+        }
+        CHECK( std::chrono::steady_clock::now() - start < std::chrono::seconds(5) );
+    }
+    return 0;
+}
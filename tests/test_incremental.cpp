@@ -0,0 +1,139 @@
+// In incremental mode a node only runs if one of its inputs has a new
+// revision since it last ran. Skipped nodes keep their outputs, so their
+// dependents can be skipped too. set() always makes a new revision,
+// set_if_changed() only when the value differs, and keep() never does.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "check.h"
+
+#include <string>
+
+enum class mode { set, set_if_changed, keep };
+
+struct Source
+{
+    graphe::out_resource<int> out;
+    int  * value;
+    mode * how;
+    Source( graphe::ResourceRegistry & G, std::string name, int * v, mode * m) : value(v), how(m)
+    {
+        out = G.register_output_resource<int>(name);
+    }
+    void operator()()
+    {
+        if( *how == mode::keep && out.has_value() )
+            out.keep();
+        else if( *how == mode::set_if_changed )
+            out.set_if_changed(*value);
+        else
+            out.set(*value);
+    }
+};
+
+struct Double
+{
+    graphe::in_resource<int>  in;
+    graphe::out_resource<int> out;
+    int * runs;
+    Double( graphe::ResourceRegistry & G, std::string i, std::string o, int * r) : runs(r)
+    {
+        in  = G.register_input_resource<int>(i);
+        out = G.register_output_resource<int>(o);
+    }
+    void operator()()
+    {
+        ++*runs;
+        out.set( 2 * in.get() );
+    }
+};
+
+struct Add
+{
+    graphe::in_resource<int> a;
+    graphe::in_resource<int> b;
+    int * result;
+    int * runs;
+    Add( graphe::ResourceRegistry & G, int * r, int * n) : result(r), runs(n)
+    {
+        a = G.register_input_resource<int>("a2");
+        b = G.register_input_resource<int>("b2");
+    }
+    void operator()()
+    {
+        ++*runs;
+        *result = a.get() + b.get();
+    }
+};
+
+int main()
+{
+    // a -> a2, b -> b2, a2 + b2 -> add
+    int  a = 1, b = 10;
+    mode how_a = mode::set_if_changed;
+    mode how_b = mode::set_if_changed;
+    int  runs_a = 0, runs_b = 0, runs_add = 0;
+    int  result = 0;
+
+    graphe::node_graph G;
+    G.set_incremental(true);
+    G.add_node<Source>("a", &a, &how_a);
+    G.add_node<Source>("b", &b, &how_b);
+    G.add_node<Double>("a", "a2", &runs_a);
+    G.add_node<Double>("b", "b2", &runs_b);
+    auto & add = G.add_node<Add>(&result, &runs_add);
+    G.compile();
+    graphe::serial_executor Exec(G);
+
+    auto frame = [&]
+    {
+        runs_a = runs_b = runs_add = 0;
+        Exec.execute();
+        G.reset();
+    };
+
+    // everything runs the first time
+    frame();
+    CHECK( runs_a == 1 && runs_b == 1 && runs_add == 1 );
+    CHECK( result == 22 );
+    CHECK( G.get_num_skipped() == 0 );
+
+    // nothing changed: the sources run, everything else is skipped
+    frame();
+    CHECK( runs_a == 0 && runs_b == 0 && runs_add == 0 );
+    CHECK( G.get_num_skipped() == 3 );
+    CHECK( result == 22 );
+
+    // only a changed: b's branch is skipped
+    a = 2;
+    frame();
+    CHECK( runs_a == 1 && runs_b == 0 && runs_add == 1 );
+    CHECK( G.get_num_skipped() == 1 );
+    CHECK( result == 24 );
+
+    // set() makes a new revision even if the value is the same
+    how_b = mode::set;
+    frame();
+    CHECK( runs_a == 0 && runs_b == 1 && runs_add == 1 );
+    CHECK( result == 24 );
+
+    // keep() never does
+    how_b = mode::keep;
+    b = 100;
+    frame();
+    CHECK( runs_b == 0 && runs_add == 0 );
+    CHECK( result == 24 );
+
+    // a node which opts out always runs
+    add.set_incremental(false);
+    frame();
+    CHECK( runs_a == 0 && runs_b == 0 && runs_add == 1 );
+    CHECK( G.get_num_skipped() == 2 );
+
+    // without incremental mode, every node runs
+    G.set_incremental(false);
+    frame();
+    CHECK( runs_a == 1 && runs_b == 1 && runs_add == 1 );
+    CHECK( G.get_num_skipped() == 0 );
+    return 0;
+}
@@ -0,0 +1,126 @@
+// With inline continuation, the first dependent a node makes ready runs on
+// the same thread once the node returns, and only the other dependents are
+// handed to the pool: a chain is one task, a fan-out of n is 1 + (n-1).
+
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// counts the tasks handed to the pool
+struct CountingWrapper
+{
+    CountingWrapper( gnl::thread_pool & T) : m_threadpool(&T)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        ++m_posted;
+        m_threadpool->post(exec);
+    }
+    gnl::thread_pool * m_threadpool;
+    std::atomic<int>   m_posted{0};
+};
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("r_0");
+    }
+    void operator()()
+    {
+        x.set(0);
+    }
+};
+
+// r_{i-1} -> r_i
+struct Link
+{
+    graphe::in_resource<int>  in;
+    graphe::out_resource<int> out;
+    Link( graphe::ResourceRegistry & G, int i)
+    {
+        in  = G.register_input_resource<int>( "r_" + std::to_string(i-1) );
+        out = G.register_output_resource<int>( "r_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        out.set( in.get() + 1 );
+    }
+};
+
+// r_0 -> b_i
+struct Branch
+{
+    graphe::in_resource<int>  in;
+    graphe::out_resource<int> out;
+    Branch( graphe::ResourceRegistry & G, int i)
+    {
+        in  = G.register_input_resource<int>("r_0");
+        out = G.register_output_resource<int>( "b_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        out.set( in.get() + 1 );
+    }
+};
+
+static int run_frames(graphe::node_graph & G, bool inline_continuation, int frames)
+{
+    gnl::thread_pool T(4);
+    CountingWrapper W(T);
+    graphe::threaded_executor<CountingWrapper> Exec(G);
+    Exec.set_thread_pool(&W);
+    Exec.set_inline_continuation(inline_continuation);
+
+    for(int i=0; i < frames; ++i)
+    {
+        Exec.execute();
+        Exec.wait();
+        G.reset();
+    }
+    return W.m_posted.load();
+}
+
+int main()
+{
+    const int length = 8;
+
+    // a chain: a single task per frame, and every link runs on one thread
+    {
+        graphe::node_graph G;
+        G.add_node<Source>();
+        for(int i=1; i <= length; ++i)
+            G.add_node<Link>(i);
+        G.compile();
+
+        CHECK( run_frames(G, false, 10) == 10 * (length + 1) );
+        CHECK( run_frames(G, true, 10) == 10 );
+
+        auto & nodes = G.get_exec_nodes();
+        for(auto & N : nodes)
+            CHECK( N->get_thread_id() == nodes.front()->get_thread_id() );
+        CHECK( G.get_resources("r_8")->Get<int>() == length );
+    }
+
+    // a fan-out: the first branch continues on the source's thread
+    {
+        const int branches = 6;
+        graphe::node_graph G;
+        G.add_node<Source>();
+        for(int i=0; i < branches; ++i)
+            G.add_node<Branch>(i);
+        G.compile();
+
+        CHECK( run_frames(G, true, 10) == 10 * branches );
+        for(int i=0; i < branches; ++i)
+            CHECK( G.get_resources( "b_" + std::to_string(i) )->Get<int>() == 1 );
+    }
+    return 0;
+}
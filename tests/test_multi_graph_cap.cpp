@@ -0,0 +1,66 @@
+// The helpers of a parallel node count towards its graph's concurrency
+// limit in the multi_graph_executor, so a capped graph cannot occupy the
+// whole pool through them.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/multi_graph_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+struct Chunks
+{
+    graphe::out_resource<int> done;
+    std::atomic<int> * active;
+    std::atomic<int> * peak;
+    std::atomic<int> * chunks;
+    Chunks( graphe::ResourceRegistry & G, int i, std::atomic<int> * a, std::atomic<int> * p, std::atomic<int> * c) : active(a), peak(p), chunks(c)
+    {
+        done = G.register_output_resource<int>( "done_" + std::to_string(i) );
+    }
+    std::size_t size()       { return 64; }
+    std::size_t chunk_size() { return 1; }
+    void operator()(std::size_t, std::size_t)
+    {
+        auto n = ++*active;
+        auto p = peak->load();
+        while( n > p && !peak->compare_exchange_weak(p, n) ) {}
+        std::this_thread::sleep_for( std::chrono::microseconds(200) );
+        --*active;
+        ++*chunks;
+    }
+    void finish()
+    {
+        done.set(1);
+    }
+};
+
+int main()
+{
+    std::atomic<int> active{0}, peak{0}, chunks{0};
+
+    graphe::node_graph G;
+    G.add_parallel_node<Chunks>(0, &active, &peak, &chunks);
+    G.add_parallel_node<Chunks>(1, &active, &peak, &chunks);
+    G.compile();
+
+    gnl::thread_pool T(4);
+    ThreadPoolWrapper W(T);
+    {
+        graphe::multi_graph_executor<ThreadPoolWrapper> Exec;
+        Exec.set_thread_pool(&W);
+        auto id = Exec.add_graph(G, 1, 1);
+
+        for(int frame=0; frame < 5; ++frame)
+        {
+            Exec.execute(id).get();
+            G.reset();
+        }
+    }
+    CHECK( chunks == 5 * 2 * 64 );
+    CHECK( peak == 1 );
+    return 0;
+}
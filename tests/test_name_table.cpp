@@ -0,0 +1,120 @@
+// resource_name_table interns names into dense ids in insertion order,
+// including while it grows and when hashes collide. A graph resolves the
+// names its nodes register, however they are spelled, to one resource.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "check.h"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace graphe::literals;
+
+static_assert( "position"_rn.hash == graphe::hash_name("position"), "the hash of a literal is computed at compile time" );
+
+struct Producer
+{
+    graphe::out_resource<int> a;
+    graphe::out_resource<int> b;
+    Producer( graphe::ResourceRegistry & G)
+    {
+        a = G.register_output_resource<int>("a"_rn);
+        b = G.register_output_resource<int>( std::string("b") );
+    }
+    void operator()()
+    {
+        a.set(3);
+        b.set(4);
+    }
+};
+
+struct Consumer
+{
+    graphe::in_resource<int> a;
+    graphe::in_resource<int> b;
+    int * out;
+    Consumer( graphe::ResourceRegistry & G, int * o) : out(o)
+    {
+        a = G.register_input_resource<int>( std::string_view("a") );
+        b = G.register_input_resource<int>("b");
+    }
+    void operator()()
+    {
+        *out = a.get() * 10 + b.get();
+    }
+};
+
+int main()
+{
+    // ids are dense and in insertion order, and survive the table growing
+    {
+        graphe::resource_name_table T;
+        const uint32_t n = 1000;
+        std::vector<std::string> names;
+        for(uint32_t i=0; i < n; ++i)
+            names.push_back( "resource_" + std::to_string(i) );
+
+        for(uint32_t i=0; i < n; ++i)
+        {
+            auto r = T.insert( graphe::resource_name(names[i]) );
+            CHECK( r.first == i );
+            CHECK( r.second );
+        }
+        CHECK( T.size() == n );
+
+        for(uint32_t i=0; i < n; ++i)
+        {
+            CHECK( T.find( graphe::resource_name(names[i]) ) == i );
+            CHECK( T.name(i) == names[i] );
+            auto r = T.insert( graphe::resource_name(names[i]) );
+            CHECK( r.first == i );
+            CHECK( !r.second );
+        }
+        CHECK( T.find("resource_1000") == graphe::resource_name_table::npos );
+        CHECK( T.size() == n );
+    }
+
+    // different names with the same hash get different ids
+    {
+        graphe::resource_name_table T;
+        graphe::resource_name x("x"), y("y"), z("z");
+        x.hash = y.hash = z.hash = 42;
+        CHECK( T.insert(x).first == 0 );
+        CHECK( T.insert(y).first == 1 );
+        CHECK( T.find(x) == 0 );
+        CHECK( T.find(y) == 1 );
+        CHECK( T.find(z) == graphe::resource_name_table::npos );
+    }
+
+    // however a name is spelled, it resolves to the same resource
+    {
+        int out = 0;
+        graphe::node_graph G;
+        G.add_node<Producer>();
+        G.add_node<Consumer>(&out);
+
+        CHECK( G.get_resource_id("a") != graphe::resource_name_table::npos );
+        CHECK( G.get_resource_id("a") == G.get_resource_id( std::string("a") ) );
+        CHECK( G.get_resource_id("b") != G.get_resource_id("a") );
+        CHECK( G.get_resource_id("c") == graphe::resource_name_table::npos );
+        CHECK( G.get_resources("b")->get_name() == "b" );
+
+        bool threw = false;
+        try
+        {
+            G.get_resources("c");
+        }
+        catch( std::out_of_range const & )
+        {
+            threw = true;
+        }
+        CHECK( threw );
+
+        graphe::serial_executor Exec(G);
+        Exec.execute();
+        CHECK( out == 34 );
+    }
+    return 0;
+}
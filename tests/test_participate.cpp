@@ -0,0 +1,160 @@
+// With wait_policy::participate the thread in wait() runs ready nodes, so
+// a frame finishes even if every worker of the pool is busy. Graphs no
+// larger than the inline threshold run entirely inside execute().
+
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set(1);
+    }
+};
+
+struct Branch
+{
+    graphe::in_resource<int>  x;
+    graphe::out_resource<int> y;
+    Branch( graphe::ResourceRegistry & G, int i)
+    {
+        x = G.register_input_resource<int>("x");
+        y = G.register_output_resource<int>( "y_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        y.set( x.get() + 1 );
+    }
+};
+
+struct Join
+{
+    std::vector< graphe::in_resource<int> > y;
+    int * sum;
+    Join( graphe::ResourceRegistry & G, int n, int * s) : sum(s)
+    {
+        for(int i=0; i < n; ++i)
+            y.push_back( G.register_input_resource<int>( "y_" + std::to_string(i) ) );
+    }
+    void operator()()
+    {
+        int s = 0;
+        for(auto & r : y)
+            s += r.get();
+        *sum = s;
+    }
+};
+
+static void build(graphe::node_graph & G, int branches, int * sum)
+{
+    G.add_node<Source>();
+    for(int i=0; i < branches; ++i)
+        G.add_node<Branch>(i);
+    G.add_node<Join>(branches, sum);
+    G.compile();
+}
+
+static bool ran_on(graphe::node_graph & G, std::thread::id id)
+{
+    for(auto & N : G.get_exec_nodes())
+    {
+        if( N->get_thread_id() != id )
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    const int branches = 8;
+    const auto self = std::this_thread::get_id();
+
+    // the only worker is busy for the whole frame: wait() runs every node
+    {
+        int sum = 0;
+        graphe::node_graph G;
+        build(G, branches, &sum);
+
+        gnl::thread_pool T(1);
+        ThreadPoolWrapper W(T);
+        std::atomic<bool> release{false};
+        std::atomic<bool> blocked{false};
+        T.post( [&]{ blocked = true; while( !release.load() ) std::this_thread::yield(); } );
+        while( !blocked.load() )
+            std::this_thread::yield();
+
+        {
+            graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+            Exec.set_thread_pool(&W);
+            Exec.set_wait_policy(graphe::wait_policy::participate);
+            for(int frame=0; frame < 5; ++frame)
+            {
+                sum = 0;
+                Exec.execute();
+                Exec.wait();
+                CHECK( G.is_idle() );
+                CHECK( sum == 2 * branches );
+                CHECK( ran_on(G, self) );
+                G.reset();
+            }
+            release = true; // the pool's tasks for the nodes run now, and find nothing to do
+        }
+    }
+
+    // with free workers, the frames are still complete
+    {
+        int sum = 0;
+        graphe::node_graph G;
+        build(G, branches, &sum);
+
+        gnl::thread_pool T(4);
+        ThreadPoolWrapper W(T);
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        Exec.set_wait_policy(graphe::wait_policy::participate);
+        for(int frame=0; frame < 200; ++frame)
+        {
+            sum = 0;
+            Exec.execute();
+            Exec.wait();
+            CHECK( sum == 2 * branches );
+            G.reset();
+        }
+    }
+
+    // a small graph runs inside execute(), without the pool
+    {
+        int sum = 0;
+        graphe::node_graph G;
+        build(G, branches, &sum);
+
+        gnl::thread_pool T(1);
+        ThreadPoolWrapper W(T);
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        Exec.set_inline_threshold( branches + 2 );
+        for(int frame=0; frame < 5; ++frame)
+        {
+            sum = 0;
+            Exec.execute();
+            CHECK( G.is_idle() );
+            CHECK( sum == 2 * branches );
+            CHECK( ran_on(G, self) );
+            Exec.wait();
+            G.reset();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+// The topology is read from a /sys/devices/system/node style tree and
+// restricted to the allowed cpus. thread_pool pins its workers according to
+// its pin_policy, and tasks posted with a NUMA node preference still run.
+
+#include "gnl/gnl_threadpool.h"
+#include "gnl/gnl_topology.h"
+#include "check.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+// the cpus the calling thread may run on
+static gnl::cpu_set this_thread_affinity()
+{
+    gnl::cpu_set cpus;
+    cpu_set_t s;
+    CPU_ZERO(&s);
+    if( sched_getaffinity(0, sizeof(s), &s) == 0 )
+    {
+        for(int c=0; c < CPU_SETSIZE; ++c)
+        {
+            if( CPU_ISSET(c, &s) )
+                cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+#endif
+
+// posts n tasks and returns the affinity each of them ran with
+static std::vector<gnl::cpu_set> run_tasks(gnl::thread_pool & T, int n, int numa_node = -1)
+{
+    std::mutex                 lock;
+    std::vector<gnl::cpu_set>  seen;
+    std::atomic<int>           done{0};
+    for(int i=0; i < n; ++i)
+    {
+        T.post( [&]
+        {
+#if defined(__linux__)
+            {
+                std::lock_guard<std::mutex> L(lock);
+                seen.push_back( this_thread_affinity() );
+            }
+#endif
+            ++done; // the last access, run_tasks() may return right after
+        }, numa_node);
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while( done.load() != n && std::chrono::steady_clock::now() < deadline )
+        std::this_thread::yield();
+    CHECK( done.load() == n );
+    std::lock_guard<std::mutex> L(lock);
+    return seen;
+}
+
+int main()
+{
+    // cpu lists
+    CHECK( (gnl::parse_cpu_list("0-3,8-11") == gnl::cpu_set{0,1,2,3,8,9,10,11}) );
+    CHECK( (gnl::parse_cpu_list("5") == gnl::cpu_set{5}) );
+    CHECK( (gnl::parse_cpu_list("0-1, 4\n") == gnl::cpu_set{0,1,4}) );
+    CHECK( gnl::parse_cpu_list("").empty() );
+
+    // a fake tree: node ids may have gaps, cpus which are not allowed are
+    // dropped, and so are nodes left without cpus
+    {
+        namespace fs = std::filesystem;
+        auto root = fs::temp_directory_path() / "graphe_test_topology";
+        fs::remove_all(root);
+        auto node = [&](int id, char const * cpulist)
+        {
+            fs::create_directories( root / ("node" + std::to_string(id)) );
+            std::ofstream( root / ("node" + std::to_string(id)) / "cpulist" ) << cpulist << "\n";
+        };
+        node(0, "0-3");
+        node(2, "4-7");
+        node(3, "8-9");
+
+        auto T = gnl::cpu_topology::discover( root.string(), gnl::cpu_set{1,2,5,7} );
+        CHECK( T.num_nodes() == 2 );
+        CHECK( T.nodes()[0].id == 0 );
+        CHECK( (T.nodes()[0].cpus == gnl::cpu_set{1,2}) );
+        CHECK( T.nodes()[1].id == 2 );
+        CHECK( (T.nodes()[1].cpus == gnl::cpu_set{5,7}) );
+        CHECK( (T.cpus() == gnl::cpu_set{1,2,5,7}) );
+        CHECK( T.node_of(5) == 1 );
+        CHECK( T.node_of(9) == 0 );
+
+        // without the tree, every allowed cpu is on one node
+        auto U = gnl::cpu_topology::discover( (root / "missing").string(), gnl::cpu_set{0,1} );
+        CHECK( U.num_nodes() == 1 );
+        CHECK( (U.nodes()[0].cpus == gnl::cpu_set{0,1}) );
+
+        fs::remove_all(root);
+    }
+
+    auto & topology = gnl::cpu_topology::get();
+    auto   allowed  = gnl::cpu_topology::allowed_cpus();
+    CHECK( topology.num_nodes() >= 1 );
+    CHECK( topology.cpus().size() == allowed.size() );
+
+    // workers run unpinned where the affinity cannot be set, then only
+    // check that the tasks run
+    bool can_pin = false;
+    std::thread( [&]{ can_pin = gnl::pin_this_thread( gnl::cpu_set{ allowed.front() } ); } ).join();
+
+    // one cpu per worker
+    {
+        gnl::thread_pool T(4, gnl::pin_policy::cpu);
+        CHECK( T.num_groups() == 1 );
+        for(auto & cpus : run_tasks(T, 64))
+        {
+            if( !can_pin ) continue;
+            CHECK( cpus.size() == 1 );
+            CHECK( std::find(allowed.begin(), allowed.end(), cpus[0]) != allowed.end() );
+        }
+    }
+
+    // one group per node: the workers may run on any cpu of their node
+    {
+        gnl::thread_pool T(4, gnl::pin_policy::numa_node);
+        CHECK( T.num_groups() == topology.num_nodes() );
+        for(std::size_t n=0; n < topology.num_nodes(); ++n)
+        {
+            for(auto & cpus : run_tasks(T, 16, static_cast<int>(n)))
+                CHECK( !cpus.empty() );
+        }
+        run_tasks(T, 16, -1);
+    }
+
+    // workers added on explicit cpus
+    {
+        gnl::thread_pool T;
+        T.create_workers(2, gnl::cpu_set{ allowed.front() });
+        CHECK( T.num_workers() == 2 );
+        for(auto & cpus : run_tasks(T, 16))
+            CHECK( !can_pin || (cpus == gnl::cpu_set{ allowed.front() }) );
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Transient resources which share storage in a serial run must get their
+// own storage under the pipelined_executor, whatever its depth: it invokes
+// nodes directly, so it does not wait for the previous occupant of a slot
+// to be destroyed.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/pipelined_executor.h"
+#include "graph-e/serial_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct A
+{
+    graphe::out_resource< std::vector<int> > x;
+    A( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource< std::vector<int> >("x");
+    }
+    void operator()()
+    {
+        x.set( std::vector<int>(100, 1) );
+    }
+};
+
+struct B
+{
+    graphe::in_resource< std::vector<int> > x;
+    graphe::out_resource<int>               y;
+    B( graphe::ResourceRegistry & G)
+    {
+        x = G.register_input_resource< std::vector<int> >("x");
+        y = G.register_output_resource<int>("y");
+    }
+    void operator()()
+    {
+        int s = 0;
+        for(auto v : x.get())
+            s += v;
+        y.set(s);
+    }
+};
+
+struct C
+{
+    graphe::in_resource<int>          y;
+    graphe::out_resource<std::string> z;
+    C( graphe::ResourceRegistry & G)
+    {
+        y = G.register_input_resource<int>("y");
+        z = G.register_output_resource<std::string>("z");
+    }
+    void operator()()
+    {
+        z.set( std::string(64, 'z') + std::to_string( y.get() ) ); // too long for the small string buffer
+    }
+};
+
+struct D
+{
+    graphe::in_resource<std::string> z;
+    std::atomic<int> * frames;
+    D( graphe::ResourceRegistry & G, std::atomic<int> * f) : frames(f)
+    {
+        z = G.register_input_resource<std::string>("z");
+    }
+    void operator()()
+    {
+        if( z.get() == std::string(64, 'z') + "100" )
+            ++*frames;
+    }
+};
+
+int main()
+{
+    gnl::thread_pool T(2);
+    ThreadPoolWrapper W(T);
+
+    for(uint32_t depth : {1u, 3u})
+    {
+        std::atomic<int> frames{0};
+
+        graphe::node_graph G;
+        G.set_transient_aliasing(true);
+        G.add_node<A>();
+        G.add_node<B>();
+        G.add_node<C>();
+        G.add_node<D>(&frames);
+        G.compile();
+        CHECK( G.get_plan().transient_pool_bytes < G.get_plan().transient_bytes ); // x and z share a slot
+
+        {
+            graphe::pipelined_executor<ThreadPoolWrapper> Exec(G, depth);
+            Exec.set_thread_pool(&W);
+            CHECK( !G.get_resources("x")->is_transient() );
+            for(int i=0; i < 20; ++i)
+                Exec.execute();
+            Exec.wait();
+        }
+        CHECK( frames == 20 );
+
+        // aliasing is restored for the other executors
+        CHECK( G.get_resources("x")->is_transient() );
+        CHECK( G.get_plan().transient_pool_bytes < G.get_plan().transient_bytes );
+
+        graphe::serial_executor S(G);
+        S.execute();
+        G.reset();
+        CHECK( frames == 21 );
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// A permanent resource has a single version, shared by every frame in
+// flight. The pipelined_executor accepts it from a one-shot node, and
+// rejects a node which writes it every frame, as the writer of frame f+1
+// could overwrite it while a reader of frame f is using it.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/pipelined_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <stdexcept>
+
+struct Writer
+{
+    graphe::out_resource<int> table;
+    Writer( graphe::ResourceRegistry & G)
+    {
+        table = G.register_output_resource<int, graphe::resource_flags::permanent>("table");
+    }
+    void operator()()
+    {
+        table.emplace(7);
+        table.make_available();
+    }
+};
+
+struct Reader
+{
+    graphe::in_resource<int> table;
+    std::atomic<int> * sum;
+    Reader( graphe::ResourceRegistry & G, std::atomic<int> * s) : sum(s)
+    {
+        table = G.register_input_resource<int, graphe::resource_flags::permanent>("table");
+    }
+    void operator()()
+    {
+        *sum += table.get();
+    }
+};
+
+int main()
+{
+    gnl::thread_pool T(4);
+    ThreadPoolWrapper W(T);
+
+    {
+        std::atomic<int> sum{0};
+        graphe::node_graph G;
+        G.add_node<Writer>();
+        G.add_node<Reader>(&sum);
+
+        bool rejected = false;
+        try
+        {
+            graphe::pipelined_executor<ThreadPoolWrapper> Exec(G, 3);
+        }
+        catch( std::runtime_error & )
+        {
+            rejected = true;
+        }
+        CHECK( rejected );
+        CHECK( G.get_resources("table")->get_num_versions() == 1 );
+    }
+
+    {
+        std::atomic<int> sum{0};
+        graphe::node_graph G;
+        G.add_oneshot_node<Writer>();
+        G.add_node<Reader>(&sum);
+
+        graphe::pipelined_executor<ThreadPoolWrapper> Exec(G, 3);
+        Exec.set_thread_pool(&W);
+        for(int i=0; i < 20; ++i)
+            Exec.execute();
+        Exec.wait();
+        CHECK( sum == 20 * 7 );
+    }
+    return 0;
+}
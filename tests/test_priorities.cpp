@@ -0,0 +1,129 @@
+// compile() gives each node the length of the longest path from it to the
+// end of the graph, and schedule_policy::critical_path runs the ready node
+// with the longest path first. update_priorities() recomputes the
+// priorities from the measured durations.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/ready_queue.h"
+#include "graph-e/serial_executor.h"
+#include "check.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set(1);
+    }
+};
+
+struct Step
+{
+    graphe::in_resource<int>  in;
+    graphe::out_resource<int> out;
+    std::string                 name;
+    std::vector<std::string>  * log;
+    std::chrono::microseconds * sleep;
+
+    Step( graphe::ResourceRegistry & G, std::string n, std::string i, std::string o,
+          std::vector<std::string> * l, std::chrono::microseconds * s) : name(n), log(l), sleep(s)
+    {
+        in  = G.register_input_resource<int>(i);
+        out = G.register_output_resource<int>(o);
+    }
+    void operator()()
+    {
+        log->push_back(name);
+        if( sleep->count() )
+            std::this_thread::sleep_for(*sleep);
+        out.set( in.get() + 1 );
+    }
+};
+
+int main()
+{
+    // nodes with equal priority are popped in the order they were pushed
+    {
+        graphe::node_graph G;
+        std::vector<std::string> log;
+        std::chrono::microseconds none{0};
+        auto & a = G.add_node<Step>("a", "x", "a", &log, &none);
+        auto & b = G.add_node<Step>("b", "x", "b", &log, &none);
+        auto & c = G.add_node<Step>("c", "x", "c", &log, &none);
+        a.set_cost(5ns); b.set_cost(5ns); c.set_cost(7ns);
+        G.compile();
+
+        graphe::ready_queue Q;
+        Q.push(&a); Q.push(&b); Q.push(&c);
+        CHECK( Q.pop() == &c );
+        CHECK( Q.pop() == &a );
+        CHECK( Q.pop() == &b );
+        CHECK( Q.empty() );
+    }
+
+    // x -> short
+    //   -> chain_1 -> chain_2 -> chain_3
+    std::vector<std::string> log;
+    std::chrono::microseconds short_sleep{0};
+    std::chrono::microseconds chain_sleep{0};
+
+    graphe::node_graph G;
+    G.add_node<Source>();
+    auto & s  = G.add_node<Step>("short",   "x",  "s",  &log, &short_sleep);
+    auto & c1 = G.add_node<Step>("chain_1", "x",  "c1", &log, &chain_sleep);
+    auto & c2 = G.add_node<Step>("chain_2", "c1", "c2", &log, &chain_sleep);
+    auto & c3 = G.add_node<Step>("chain_3", "c2", "c3", &log, &chain_sleep);
+    s.set_cost(1us);
+    c1.set_cost(100us);
+    c2.set_cost(100us);
+    c3.set_cost(100us);
+    G.compile();
+
+    CHECK( c3.get_priority() == 100000 );
+    CHECK( c2.get_priority() == 200000 );
+    CHECK( c1.get_priority() == 300000 );
+    CHECK( s.get_priority()  == 1000 );
+
+    graphe::serial_executor Exec(G);
+
+    // fifo: in the order the nodes became ready
+    Exec.execute();
+    G.reset();
+    CHECK( log.size() == 4 );
+    CHECK( log[0] == "short" );
+
+    // critical path: the chain starts first
+    Exec.set_policy( graphe::schedule_policy::critical_path );
+    log.clear();
+    Exec.execute();
+    G.reset();
+    CHECK( (log == std::vector<std::string>{"chain_1", "chain_2", "chain_3", "short"}) );
+
+    // measured: the short node now takes longer than the whole chain
+    short_sleep = 20ms;
+    for(int i=0; i < 4; ++i)
+    {
+        Exec.execute();
+        G.update_priorities();
+        G.reset();
+    }
+    CHECK( s.get_priority() > c1.get_priority() );
+
+    log.clear();
+    short_sleep = 0us;
+    Exec.execute();
+    G.reset();
+    CHECK( log[0] == "short" );
+    return 0;
+}
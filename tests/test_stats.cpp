@@ -0,0 +1,120 @@
+// node_stats keeps a rolling window of durations: the count is the total,
+// the mean, min, max and percentiles only cover the window. Graphs only
+// record while profiling is enabled, and recording does not allocate once
+// the windows are reserved.
+
+#define GRAPHE_TRACK_ALLOCATIONS
+#include "graph-e/alloc_tracker.h"
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "check.h"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set(1);
+    }
+};
+
+struct Slow
+{
+    graphe::in_resource<int> x;
+    Slow( graphe::ResourceRegistry & G)
+    {
+        x = G.register_input_resource<int>("x");
+    }
+    void operator()()
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+};
+
+int main()
+{
+    // the window
+    {
+        graphe::node_stats S;
+        CHECK( S.count() == 0 );
+        CHECK( S.mean() == 0ns );
+        CHECK( S.p99() == 0ns );
+
+        for(int i=1; i <= 100; ++i)
+            S.record( std::chrono::nanoseconds(i) );
+        CHECK( S.count() == 100 );
+        CHECK( S.min() == 1ns );
+        CHECK( S.max() == 100ns );
+        CHECK( S.mean() == 50ns );
+        CHECK( S.p50() == 51ns );
+        CHECK( S.p99() == 99ns );
+
+        // the oldest durations are replaced once the window is full
+        for(std::size_t i=0; i < graphe::node_stats::window_size; ++i)
+            S.record(1000ns);
+        CHECK( S.count() == 100 + graphe::node_stats::window_size );
+        CHECK( S.min() == 1000ns );
+        CHECK( S.max() == 1000ns );
+
+        S.clear();
+        CHECK( S.count() == 0 );
+        CHECK( S.max() == 0ns );
+    }
+
+    graphe::node_graph G;
+    G.add_node<Source>().set_name("source");
+    G.add_node<Slow>().set_name("slow");
+    G.compile();
+    graphe::serial_executor Exec(G);
+
+    CHECK( G.get_stats("slow") != nullptr );
+    CHECK( G.get_stats("missing") == nullptr );
+
+    // nothing is recorded unless profiling is enabled
+    Exec.execute();
+    G.reset();
+    CHECK( G.get_stats("slow")->count() == 0 );
+
+    G.set_profiling(true);
+    Exec.execute();
+    G.reset();
+
+    graphe::allocation_tracker::begin();
+    for(int i=0; i < 9; ++i)
+    {
+        Exec.execute();
+        G.reset();
+    }
+    CHECK( graphe::allocation_tracker::end() == 0 );
+
+    auto S = G.get_stats("slow");
+    CHECK( S->count() == 10 );
+    CHECK( S->min() >= 1ms );
+    CHECK( S->min() <= S->p50() && S->p50() <= S->p99() && S->p99() <= S->max() );
+    CHECK( G.get_stats("source")->count() == 10 );
+
+    std::ostringstream out;
+    G.print_stats(out);
+    CHECK( out.str().find("slow") != std::string::npos );
+    CHECK( out.str().find("p99") != std::string::npos );
+
+    G.clear_stats();
+    CHECK( S->count() == 0 );
+
+    G.set_profiling(false);
+    Exec.execute();
+    G.reset();
+    CHECK( S->count() == 0 );
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Once a graph has run a few frames, executing a frame must not allocate:
+// resources reuse their storage and the executors reuse their queues. The
+// replacement operator new counts every allocation made by any thread
+// between allocation_tracker::begin() and end().
+
+#define GRAPHE_TRACK_ALLOCATIONS
+#include "graph-e/alloc_tracker.h"
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <vector>
+
+struct Producer
+{
+    graphe::out_resource<std::vector<float>> v;
+    graphe::out_resource<int>                n;
+
+    Producer( graphe::ResourceRegistry & G)
+    {
+        v = G.register_output_resource<std::vector<float>>("v");
+        n = G.register_output_resource<int>("n");
+    }
+    void operator()()
+    {
+        if( !v.has_value() )
+            v.emplace();
+        v.get().assign(256, 1.0f);
+        v.make_available();
+        n.set(2);
+    }
+};
+
+struct Sum
+{
+    graphe::in_resource<std::vector<float>> v;
+    graphe::in_resource<int>                n;
+    graphe::out_resource<float>             s;
+
+    Sum( graphe::ResourceRegistry & G)
+    {
+        v = G.register_input_resource<std::vector<float>>("v");
+        n = G.register_input_resource<int>("n");
+        s = G.register_output_resource<float>("s");
+    }
+    void operator()()
+    {
+        float t = 0;
+        for(auto x : v.get())
+            t += x;
+        s.set( t * static_cast<float>(n.get()) );
+    }
+};
+
+struct Inc
+{
+    graphe::in_resource<int>  n;
+    graphe::out_resource<int> m;
+
+    Inc( graphe::ResourceRegistry & G)
+    {
+        n = G.register_input_resource<int>("n");
+        m = G.register_output_resource<int>("m");
+    }
+    void operator()()
+    {
+        m.set( n.get() + 1 );
+    }
+};
+
+struct Result
+{
+    graphe::in_resource<float> s;
+    graphe::in_resource<int>   m;
+    float * out;
+
+    Result( graphe::ResourceRegistry & G, float * o) : out(o)
+    {
+        s = G.register_input_resource<float>("s");
+        m = G.register_input_resource<int>("m");
+    }
+    void operator()()
+    {
+        *out = s.get() + static_cast<float>(m.get());
+    }
+};
+
+static void build(graphe::node_graph & G, float * out)
+{
+    G.add_node<Producer>().set_name("producer");
+    G.add_node<Sum>().set_name("sum");
+    G.add_node<Inc>().set_name("inc");
+    G.add_node<Result>(out).set_name("result");
+    G.compile();
+}
+
+// runs a few frames to warm up, then counts the allocations of the next ones
+template<typename F>
+static uint64_t steady_state_allocations(graphe::node_graph & G, F && frame)
+{
+    for(int i=0; i < 3; ++i)
+    {
+        frame();
+        G.reset();
+    }
+
+    graphe::allocation_tracker::begin();
+    for(int i=0; i < 20; ++i)
+    {
+        frame();
+        G.reset();
+    }
+    return graphe::allocation_tracker::end();
+}
+
+static void * volatile g_probe;
+
+int main()
+{
+    CHECK( graphe::allocation_tracker::is_installed() );
+
+    // the tracker sees allocations at all
+    graphe::allocation_tracker::begin();
+    g_probe = ::operator new(16);
+    ::operator delete(g_probe);
+    CHECK( graphe::allocation_tracker::end() == 1 );
+
+    {
+        float out = 0;
+        graphe::node_graph G;
+        build(G, &out);
+
+        graphe::serial_executor Exec(G);
+        auto n = steady_state_allocations(G, [&]{ Exec.execute(); });
+        CHECK( n == 0 );
+        CHECK( out == 256.0f * 2 + 3 );
+    }
+
+    {
+        float out = 0;
+        graphe::node_graph G;
+        build(G, &out);
+
+        gnl::thread_pool T(4);
+        ThreadPoolWrapper W(T);
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        auto n = steady_state_allocations(G, [&]{ Exec.execute(); Exec.wait(); });
+        CHECK( n == 0 );
+        CHECK( out == 256.0f * 2 + 3 );
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+// gnl::task stores small callables inline, so creating, moving and running
+// one does not allocate, and larger ones on the heap. Every callable is
+// destroyed exactly once. thread_pool::post() does not allocate once its
+// queue has grown to its working size.
+
+#define GRAPHE_TRACK_ALLOCATIONS
+#include "graph-e/alloc_tracker.h"
+#include "gnl/gnl_task.h"
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static int g_live  = 0;
+static int g_calls = 0;
+
+// counts the live instances, so a leak or a double destruction is seen
+template<std::size_t N>
+struct counted
+{
+    void * payload[N] = {};
+    counted() { ++g_live; }
+    counted(counted && ) noexcept { ++g_live; }
+    counted(counted const & ) { ++g_live; }
+    ~counted() { --g_live; }
+    void operator()() { ++g_calls; }
+};
+
+using small_fn = counted<2>;
+using large_fn = counted<16>;
+
+struct throwing_move
+{
+    throwing_move() = default;
+    throwing_move(throwing_move &&) noexcept(false) {}
+    void operator()() {}
+};
+
+int main()
+{
+    static_assert( gnl::task::stored_inline<small_fn>(), "a small callable is stored inline" );
+    static_assert( !gnl::task::stored_inline<large_fn>(), "a large callable is stored on the heap" );
+    static_assert( !gnl::task::stored_inline<throwing_move>(), "a callable which may throw when moved is stored on the heap" );
+
+    // small callables: no allocation, whatever is done with the task
+    {
+        graphe::allocation_tracker::begin();
+        {
+            gnl::task a{ small_fn() };
+            gnl::task b( std::move(a) );
+            CHECK( !a );
+            CHECK( b );
+            b();
+            gnl::task c;
+            c = std::move(b);
+            c();
+        }
+        CHECK( graphe::allocation_tracker::end() == 0 );
+        CHECK( g_live == 0 );
+        CHECK( g_calls == 2 );
+    }
+
+    // large callables: a single allocation, moving the task moves the pointer
+    {
+        g_calls = 0;
+        graphe::allocation_tracker::begin();
+        {
+            gnl::task a{ large_fn() };
+            gnl::task b( std::move(a) );
+            b();
+        }
+        CHECK( graphe::allocation_tracker::end() == 1 );
+        CHECK( g_live == 0 );
+        CHECK( g_calls == 1 );
+    }
+
+    // assigning to a task or resetting it destroys the callable it held
+    {
+        gnl::task a{ small_fn() };
+        gnl::task b{ large_fn() };
+        CHECK( g_live == 2 );
+        a = std::move(b);
+        CHECK( g_live == 1 );
+        a.reset();
+        CHECK( !a );
+        CHECK( g_live == 0 );
+    }
+
+    // the ring queue keeps its FIFO order while it grows and wraps around
+    {
+        gnl::ring_queue<int> Q(2);
+        int next_in = 0, next_out = 0;
+        for(int round=0; round < 100; ++round)
+        {
+            for(int i=0; i < round % 7 + 1; ++i)
+                Q.push(next_in++);
+            for(int i=0; i < round % 5 + 1 && !Q.empty(); ++i)
+                CHECK( Q.pop() == next_out++ );
+        }
+        while( !Q.empty() )
+            CHECK( Q.pop() == next_out++ );
+        CHECK( next_in == next_out );
+    }
+
+    // posting small tasks does not allocate once the queue has grown
+    {
+        gnl::thread_pool T(2);
+        std::atomic<int> done{0};
+
+        auto post_and_wait = [&](int n)
+        {
+            done = 0;
+            for(int i=0; i < n; ++i)
+                T.post( [&done]{ ++done; } );
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while( done.load() != n && std::chrono::steady_clock::now() < deadline )
+                std::this_thread::yield();
+            return done.load() == n;
+        };
+
+        CHECK( post_and_wait(256) );
+
+        graphe::allocation_tracker::begin();
+        bool ok = post_and_wait(200);
+        auto n = graphe::allocation_tracker::end();
+        CHECK( ok );
+        CHECK( n == 0 );
+    }
+    return 0;
+}
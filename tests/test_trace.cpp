@@ -0,0 +1,128 @@
+// trace_recorder records one span per node execution and one instant event
+// per resource, on one track per thread. The metadata of each track names
+// the std::thread::id of its thread, and a thread's cache of rings does not
+// keep the entries of destroyed recorders.
+
+#include "graph-e/node_graph.h"
+#include "graph-e/serial_executor.h"
+#include "graph-e/threaded_executor.h"
+#include "graph-e/trace.h"
+#include "check.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set(1);
+    }
+};
+
+struct Branch
+{
+    graphe::in_resource<int>  x;
+    graphe::out_resource<int> y;
+    Branch( graphe::ResourceRegistry & G, int i)
+    {
+        x = G.register_input_resource<int>("x");
+        y = G.register_output_resource<int>( "y_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        y.set( x.get() + 1 );
+    }
+};
+
+// exposes the calling thread's cache of rings
+struct probe_recorder : graphe::trace_recorder
+{
+    using graphe::trace_recorder::trace_recorder;
+    static std::size_t cached_rings()
+    {
+        return thread_cache().size();
+    }
+};
+
+static std::size_t count(std::string const & s, std::string const & what)
+{
+    std::size_t n = 0;
+    for(auto p = s.find(what); p != std::string::npos; p = s.find(what, p + what.size()))
+        ++n;
+    return n;
+}
+
+int main()
+{
+    const int branches = 4;
+    const std::size_t events_per_frame = 2 * (1 + branches); // a span per node, an instant per resource
+
+    graphe::node_graph G;
+    G.add_node<Source>().set_name("source");
+    for(int i=0; i < branches; ++i)
+        G.add_node<Branch>(i).set_name( "branch_" + std::to_string(i) );
+    G.compile();
+
+    {
+        graphe::serial_executor Exec(G);
+        for(int i=0; i < 50; ++i)
+        {
+            probe_recorder T(G);
+            Exec.execute();
+            T.flush();
+            G.reset();
+            CHECK( T.size() == events_per_frame );
+            CHECK( probe_recorder::cached_rings() == 1 );
+        }
+
+        probe_recorder T(G);
+        Exec.execute();
+        T.flush();
+        G.reset();
+
+        std::ostringstream out;
+        T.write(out);
+        auto json = out.str();
+
+        std::ostringstream id;
+        id << std::this_thread::get_id();
+        CHECK( count(json, "\"ph\":\"M\"") == 1 );
+        CHECK( json.find("\"thread_id\":\"" + id.str() + "\"") != std::string::npos );
+        CHECK( count(json, "\"ph\":\"X\"") == 1 + branches );
+        CHECK( count(json, "\"ph\":\"i\"") == 1 + branches );
+        CHECK( json.find("\"name\":\"branch_3\"") != std::string::npos );
+    }
+
+    {
+        gnl::thread_pool P(4);
+        ThreadPoolWrapper W(P);
+        graphe::threaded_executor<ThreadPoolWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+
+        probe_recorder T(G);
+        for(int i=0; i < 20; ++i)
+        {
+            Exec.execute();
+            Exec.wait();
+            T.flush();
+            G.reset();
+        }
+        CHECK( T.dropped() == 0 );
+        CHECK( T.size() == 20 * events_per_frame );
+
+        std::ostringstream out;
+        T.write(out);
+        auto json = out.str();
+        auto tracks = count(json, "\"ph\":\"M\"");
+        CHECK( tracks >= 1 && tracks <= 5 ); // the pool's workers, and possibly the waiting thread
+        CHECK( count(json, "\"thread_id\":\"") == tracks );
+    }
+    return 0;
+}
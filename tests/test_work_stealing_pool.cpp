@@ -0,0 +1,198 @@
+// chase_lev_deque hands out every item exactly once, LIFO to its owner and
+// FIFO to thieves, also while it grows. work_stealing_pool runs tasks
+// pushed from outside and from its own workers, and can drive a
+// threaded_executor through push_ref().
+
+#include "gnl/gnl_work_stealing_pool.h"
+#include "graph-e/node_graph.h"
+#include "graph-e/threaded_executor.h"
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+template<typename F>
+static bool wait_for(F && done)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while( !done() )
+    {
+        if( std::chrono::steady_clock::now() > deadline )
+            return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+struct WorkStealingWrapper
+{
+    WorkStealingWrapper( gnl::work_stealing_pool & P) : m_pool(&P)
+    {
+    }
+    void operator()( std::function<void(void)> & exec)
+    {
+        m_pool->push_ref(exec);
+    }
+    gnl::work_stealing_pool * m_pool;
+};
+
+struct Source
+{
+    graphe::out_resource<int> x;
+    Source( graphe::ResourceRegistry & G)
+    {
+        x = G.register_output_resource<int>("x");
+    }
+    void operator()()
+    {
+        x.set(1);
+    }
+};
+
+struct Branch
+{
+    graphe::in_resource<int>  x;
+    graphe::out_resource<int> y;
+    Branch( graphe::ResourceRegistry & G, int i)
+    {
+        x = G.register_input_resource<int>("x");
+        y = G.register_output_resource<int>( "y_" + std::to_string(i) );
+    }
+    void operator()()
+    {
+        y.set( x.get() + 1 );
+    }
+};
+
+struct Join
+{
+    std::vector< graphe::in_resource<int> > y;
+    int * sum;
+    Join( graphe::ResourceRegistry & G, int n, int * s) : sum(s)
+    {
+        for(int i=0; i < n; ++i)
+            y.push_back( G.register_input_resource<int>( "y_" + std::to_string(i) ) );
+    }
+    void operator()()
+    {
+        int s = 0;
+        for(auto & r : y)
+            s += r.get();
+        *sum = s;
+    }
+};
+
+int main()
+{
+    // single thread: the owner pops LIFO, thieves steal FIFO, the buffer grows
+    {
+        gnl::chase_lev_deque D(4);
+        for(std::uintptr_t i=1; i <= 100; ++i)
+            D.push(i);
+        CHECK( D.size() == 100 );
+        CHECK( D.steal() == 1 );
+        CHECK( D.steal() == 2 );
+        for(std::uintptr_t i=100; i >= 3; --i)
+            CHECK( D.pop() == i );
+        CHECK( D.pop() == 0 );
+        CHECK( D.steal() == 0 );
+    }
+
+    // the owner pushes and pops while thieves steal: every item is taken once
+    {
+        const std::uintptr_t N = 200000;
+        gnl::chase_lev_deque D(16);
+        std::unique_ptr< std::atomic<int>[] > taken( new std::atomic<int>[N+1] );
+        for(std::uintptr_t i=0; i <= N; ++i)
+            taken[i] = 0;
+        std::atomic<bool> stop{false};
+
+        std::vector<std::thread> thieves;
+        for(int t=0; t < 3; ++t)
+        {
+            thieves.emplace_back( [&]
+            {
+                while( !stop.load() )
+                {
+                    if( auto x = D.steal() )
+                        ++taken[x];
+                }
+            });
+        }
+
+        for(std::uintptr_t i=1; i <= N; ++i)
+        {
+            D.push(i);
+            if( i % 3 == 0 )
+            {
+                if( auto x = D.pop() )
+                    ++taken[x];
+            }
+        }
+        while( auto x = D.pop() )
+            ++taken[x];
+
+        stop = true;
+        for(auto & t : thieves)
+            t.join();
+
+        for(std::uintptr_t i=1; i <= N; ++i)
+            CHECK( taken[i] == 1 );
+    }
+
+    // tasks pushed by tasks go onto the worker's own deque, and are stolen by the others
+    {
+        gnl::work_stealing_pool P(4);
+        CHECK( P.num_workers() == 4 );
+        CHECK( P.current_worker() == -1 );
+
+        std::atomic<int> leaves{0};
+        std::atomic<int> not_a_worker{0};
+        std::function<void(int)> spawn = [&](int depth)
+        {
+            if( P.current_worker() < 0 )
+                ++not_a_worker;
+            if( depth == 0 )
+            {
+                ++leaves;
+                return;
+            }
+            P.push( [&spawn, depth]{ spawn(depth-1); } );
+            P.push( [&spawn, depth]{ spawn(depth-1); } );
+        };
+        P.push( [&]{ spawn(12); } );
+
+        CHECK( wait_for( [&]{ return leaves.load() == (1 << 12); } ) );
+        CHECK( not_a_worker == 0 );
+    }
+
+    // drives a threaded_executor, with the std::functions pushed by reference
+    {
+        const int branches = 16;
+        int sum = 0;
+        graphe::node_graph G;
+        G.add_node<Source>();
+        for(int i=0; i < branches; ++i)
+            G.add_node<Branch>(i);
+        G.add_node<Join>(branches, &sum);
+        G.compile();
+
+        gnl::work_stealing_pool P(4);
+        WorkStealingWrapper W(P);
+        graphe::threaded_executor<WorkStealingWrapper> Exec(G);
+        Exec.set_thread_pool(&W);
+        for(int frame=0; frame < 100; ++frame)
+        {
+            sum = 0;
+            Exec.execute();
+            Exec.wait();
+            CHECK( sum == 2 * branches );
+            G.reset();
+        }
+    }
+    return 0;
+}